@@ -7,20 +7,47 @@
 #include "secrets.h"
 #include "pin_defn.h"
 #include "global_vars.h"
+#include "led_controller.h"
+#include "sensor_stream.h"
+#include "device_config.h"
+#include "profiler.h"
+#include <freertos/queue.h>
+
+// Binary pixel stream (format in pixel_stream.h); override in secrets.h
+#ifndef PIXEL_STREAM_RX_UUID
+#define PIXEL_STREAM_RX_UUID "6e400005-b5a3-f393-e0a9-e50e24dcca9e"
+#endif
+
+// Largest ATT MTU we offer; each stream packet must fit in MTU - 3 bytes
+#define BLE_PREFERRED_MTU 517
+
+// Device info writes waiting for ble_loop() to apply them to storage
+#define DEVICE_INFO_QUEUE_LEN 64
 
 // Forward declarations for external references
-class PersistentStorage;
-class LEDController;
 extern PersistentStorage storage;
 extern LEDController ledController;
+extern SensorStream sensorStream;
 
 // Additional BLE characteristics - Define them here
 BLECharacteristic* pDeviceInfoTxCharacteristic = NULL;
 BLECharacteristic* pDeviceInfoRxCharacteristic = NULL;
 BLECharacteristic* pThemeRxCharacteristic = NULL;
+BLECharacteristic* pPixelStreamRxCharacteristic = NULL;
+
+// Storage is only touched from the loop task: the BLE task queues device info
+// payloads (as heap Strings) and ble_loop() applies them in one transaction
+QueueHandle_t deviceInfoQueue = NULL;
+
+// Set by the "restart" command; ble_loop() flushes storage and restarts
+volatile bool restartRequested = false;
+
+// The "led" and "blink" commands drive STATUS_LED_PIN unless a strip uses it
+bool statusLedAvailable = false;
 
 // Function declarations
 void handleCommand(String jsonCommand);
+void sendMetrics(JsonDocument& doc);
 void handleLEDCommand(JsonDocument& doc);
 void handleBlinkCommand(JsonDocument& doc);
 void sendSensorData();
@@ -30,6 +57,8 @@ void readSensors();
 String getChipInfo();
 void sendDeviceInfo();
 void handleDeviceInfoReceived(const String& jsonData);
+void processDeviceInfoQueue();
+void applyDeviceInfo(JsonObjectConst info);
 void handleThemeCommand(const String& jsonData);
 
 // BLE Server Callbacks
@@ -77,12 +106,29 @@ class ThemeRxCallbacks: public BLECharacteristicCallbacks {
     }
 };
 
+// Pixel Stream RX Callbacks: raw bytes go straight to the LED controller
+class PixelStreamRxCallbacks: public BLECharacteristicCallbacks {
+    void onWrite(BLECharacteristic *pCharacteristic) {
+        PROFILE_SCOPE(ProfileStage::BLE_COMMAND);
+        ledController.writeStreamPacket(pCharacteristic->getData(), pCharacteristic->getLength());
+    }
+};
+
 void ble_setup() {
   Serial.begin(115200);
-  pinMode(LED_PIN, OUTPUT);
-  digitalWrite(LED_PIN, LOW);
+  // Strips are already on their pins (setup() starts the LEDs first)
+  statusLedAvailable = !ledController.usesPin(STATUS_LED_PIN);
+  if (statusLedAvailable) {
+    pinMode(STATUS_LED_PIN, OUTPUT);
+    digitalWrite(STATUS_LED_PIN, LOW);
+  } else {
+    Serial.println("STATUS_LED_PIN " + String(STATUS_LED_PIN) + " is a strip data pin, status LED commands disabled");
+  }
+
+  deviceInfoQueue = xQueueCreate(DEVICE_INFO_QUEUE_LEN, sizeof(String*));
 
   BLEDevice::init(deviceName.c_str());
+  BLEDevice::setMTU(BLE_PREFERRED_MTU);
   pServer = BLEDevice::createServer();
   pServer->setCallbacks(new MyServerCallbacks());
 
@@ -120,6 +166,14 @@ void ble_setup() {
                            );
   pThemeRxCharacteristic->setCallbacks(new ThemeRxCallbacks());
 
+  // Pixel Stream RX (binary frames, write without response for throughput)
+  pPixelStreamRxCharacteristic = pService->createCharacteristic(
+                                   PIXEL_STREAM_RX_UUID,
+                                   BLECharacteristic::PROPERTY_WRITE |
+                                   BLECharacteristic::PROPERTY_WRITE_NR
+                                 );
+  pPixelStreamRxCharacteristic->setCallbacks(new PixelStreamRxCallbacks());
+
   pService->start();
 
   BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
@@ -151,16 +205,29 @@ void ble_loop() {
     lastDeviceInfoSent = millis();
   }
   
-  if (millis() - lastSensorRead > 2000) {
-    readSensors();
-    lastSensorRead = millis();
+  processDeviceInfoQueue();
+  
+  // Device info queued before the command is applied first, so it is kept
+  if (restartRequested) {
+    storage.flush();
+    Serial.println("Restarting...");
+    delay(100);
+    ESP.restart();
   }
-  delay(100);
+  
+  // Cheap and non-blocking: drains whatever the sampler task has queued
+  readSensors();
+  lastSensorRead = millis();
 }
 
 void handleCommand(String jsonCommand) {
+  PROFILE_SCOPE(ProfileStage::BLE_COMMAND);
   JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, jsonCommand);
+  DeserializationError error;
+  {
+    PROFILE_SCOPE(ProfileStage::JSON_PARSE);
+    error = deserializeJson(doc, jsonCommand);
+  }
   if (error) {
     Serial.println("Failed to parse JSON command");
     sendResponse("error", "Invalid JSON format");
@@ -176,27 +243,32 @@ void handleCommand(String jsonCommand) {
     sendDeviceStatus();
   } else if (command == "restart") {
     sendResponse("message", "Restarting ESP32...");
-    delay(1000);
-    ESP.restart();
+    restartRequested = true;
   } else if (command == "blink") {
     handleBlinkCommand(doc);
   } else if (command == "get_device_info") {
     sendDeviceInfo();
+  } else if (command == "metrics") {
+    sendMetrics(doc);
   } else {
     sendResponse("error", "Unknown command: " + command);
   }
 }
 
 void handleLEDCommand(JsonDocument& doc) {
+  if (!statusLedAvailable) {
+    sendResponse("error", "Status LED pin is a strip data pin");
+    return;
+  }
   String state = doc["state"];
   if (state == "ON") {
     ledState = true;
-    digitalWrite(LED_PIN, HIGH);
+    digitalWrite(STATUS_LED_PIN, HIGH);
     sendResponse("ledState", "ON");
     Serial.println("LED turned ON");
   } else if (state == "OFF") {
     ledState = false;
-    digitalWrite(LED_PIN, LOW);
+    digitalWrite(STATUS_LED_PIN, LOW);
     sendResponse("ledState", "OFF");
     Serial.println("LED turned OFF");
   } else {
@@ -205,16 +277,20 @@ void handleLEDCommand(JsonDocument& doc) {
 }
 
 void handleBlinkCommand(JsonDocument& doc) {
+  if (!statusLedAvailable) {
+    sendResponse("error", "Status LED pin is a strip data pin");
+    return;
+  }
   int times = doc["times"] | 3;
   sendResponse("message", "Blinking LED " + String(times) + " times");
   bool originalState = ledState;
   for (int i = 0; i < times; i++) {
-    digitalWrite(LED_PIN, HIGH);
+    digitalWrite(STATUS_LED_PIN, HIGH);
     delay(200);
-    digitalWrite(LED_PIN, LOW);
+    digitalWrite(STATUS_LED_PIN, LOW);
     delay(200);
   }
-  digitalWrite(LED_PIN, originalState ? HIGH : LOW);
+  digitalWrite(STATUS_LED_PIN, originalState ? HIGH : LOW);
 }
 
 void sendSensorData() {
@@ -222,6 +298,13 @@ void sendSensorData() {
   doc["sensors"]["temperature"] = random(20, 35);
   doc["sensors"]["humidity"] = random(40, 80);
   doc["sensors"]["light"] = sensorValue;
+  doc["sensors"]["light_peak"] = sensorStream.getPeak();
+  JsonArray bands = doc["sensors"]["bands"].to<JsonArray>();
+  for (int i = 0; i < SENSOR_BAND_COUNT; i++) {
+    bands.add(sensorStream.getBand(i));
+  }
+  doc["sensors"]["sample_rate"] = sensorStream.getSampleRate();
+  doc["sensors"]["sample_overruns"] = sensorStream.getOverruns();
   doc["sensors"]["ledState"] = ledState ? "ON" : "OFF";
   doc["sensors"]["uptime"] = millis();
   doc["sensors"]["timestamp"] = millis();
@@ -245,6 +328,7 @@ void sendDeviceStatus() {
   doc["status"]["deviceName"] = deviceName;
   doc["status"]["macAddress"] = String((uint32_t)ESP.getEfuseMac(), HEX);
   doc["status"]["ledState"] = ledState ? "ON" : "OFF";
+  storage.reportStats(doc["status"]["storage"].to<JsonObject>());
   String jsonString;
   serializeJson(doc, jsonString);
   if (deviceConnected) {
@@ -266,9 +350,30 @@ void sendResponse(String key, String value) {
   }
 }
 
+// Per-stage p50/p99/max in microseconds; {"command":"metrics","reset":true} clears them
+void sendMetrics(JsonDocument& command) {
+#ifdef ENABLE_PROFILER
+  JsonDocument doc;
+  profilerReport(doc["metrics"].to<JsonObject>());
+  if (command["reset"] | false) {
+    profilerReset();
+  }
+  String jsonString;
+  serializeJson(doc, jsonString);
+  if (deviceConnected) {
+    pCharacteristic->setValue(jsonString.c_str());
+    pCharacteristic->notify();
+    Serial.println("Sent metrics: " + jsonString);
+  }
+#else
+  sendResponse("error", "Profiler not enabled in this build");
+#endif
+}
+
 void readSensors() {
-  int rawValue = analogRead(SENSOR_PIN);
-  sensorValue = (rawValue / 4095.0) * 100.0;
+  PROFILE_SCOPE(ProfileStage::SENSOR);
+  sensorStream.process();
+  sensorValue = (sensorStream.getAverage() / 4095.0) * 100.0;
 }
 
 String getChipInfo() {
@@ -301,35 +406,76 @@ void sendDeviceInfo() {
 }
 
 void handleDeviceInfoReceived(const String& jsonData) {
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, jsonData);
-    
-    if (error) {
-        Serial.println("Failed to parse received device info");
-        return;
+    String* payload = new String(jsonData);
+    if (!deviceInfoQueue || xQueueSend(deviceInfoQueue, &payload, 0) != pdTRUE) {
+        Serial.println("Device info queue full, dropping payload");
+        delete payload;
     }
-    
-    if (doc["device_name"].is<const char*>()) {
-        String deviceName = doc["device_name"];
-        String deviceType = doc["device_type"] | "strip";
-        String ledType = doc["led_type"] | "WS2812B";
-        int numLeds = doc["num_of_leds"] | 30;
-        String macAddress = doc["mac_address"] | "00:00:00:00:00:00";
+}
+
+// A burst of device info writes becomes one transaction and so one flash write
+void processDeviceInfoQueue() {
+    if (!deviceInfoQueue || uxQueueMessagesWaiting(deviceInfoQueue) == 0) return;
+    PROFILE_SCOPE(ProfileStage::BLE_COMMAND);
+    storage.beginTransaction();
+    String* payload;
+    while (xQueueReceive(deviceInfoQueue, &payload, 0) == pdTRUE) {
+        JsonDocument doc;
+        DeserializationError error;
+        {
+            PROFILE_SCOPE(ProfileStage::JSON_PARSE);
+            error = deserializeJson(doc, *payload);
+        }
+        delete payload;
+        if (error) {
+            Serial.println("Failed to parse received device info");
+            continue;
+        }
+        // One device/network object, or an array of them
+        if (doc.is<JsonArrayConst>()) {
+            for (JsonObjectConst info : doc.as<JsonArrayConst>()) {
+                applyDeviceInfo(info);
+            }
+        } else {
+            applyDeviceInfo(doc.as<JsonObjectConst>());
+        }
+    }
+    storage.commitTransaction();
+}
+
+void applyDeviceInfo(JsonObjectConst info) {
+    if (info["device_name"].is<const char*>()) {
+        String deviceName = info["device_name"];
+        String deviceType = info["device_type"] | "strip";
+        String ledType = info["led_type"] | "WS2812B";
+        int numLeds = info["num_of_leds"] | 30;
+        String macAddress = info["mac_address"] | "00:00:00:00:00:00";
         
-        Serial.println("Received device info - would add to storage");
-        // Note: storage.addDevice() will be called when storage is properly linked
+        if (storage.deviceExists(deviceName)) {
+            storage.updateDeviceProperty(deviceName, "device_type", deviceType);
+            storage.updateDeviceProperty(deviceName, "led_type", ledType);
+            storage.updateDeviceProperty(deviceName, "num_of_leds", numLeds);
+        } else {
+            storage.addDevice(deviceName, deviceType, ledType, numLeds, macAddress);
+        }
     }
     
-    if (doc["ssid"].is<const char*>()) {
-        String ssid = doc["ssid"];
-        String password = doc["password"] | "";
-        Serial.println("Received network info - would add to storage");
-        // Note: storage.addNetwork() will be called when storage is properly linked
+    if (info["ssid"].is<const char*>()) {
+        String ssid = info["ssid"];
+        String password = info["password"] | "";
+        if (storage.networkExists(ssid)) {
+            storage.updateNetworkProperty(ssid, "password", password);
+        } else {
+            storage.addNetwork(ssid, password);
+        }
     }
 }
 
 void handleThemeCommand(const String& jsonData) {
-    Serial.println("Received theme command - would process with LED controller");
-    // Note: ledController.processThemeCommand() will be called when ledController is properly linked
-    sendResponse("theme_status", "received");
+    PROFILE_SCOPE(ProfileStage::BLE_COMMAND);
+    if (ledController.processThemeCommand(jsonData)) {
+        sendResponse("theme_status", "success");
+    } else {
+        sendResponse("theme_status", "failed");
+    }
 }
\ No newline at end of file
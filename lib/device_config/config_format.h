@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Binary layout of /config.bin (little-endian, as stored by the ESP32):
+//
+//   ConfigFileHeader
+//   DeviceRecord  x deviceCount   (deviceRecordSize bytes each)
+//   NetworkRecord x networkCount  (networkRecordSize bytes each)
+//   string table                  (stringsSize bytes, referenced by StringRef)
+//
+// The header and the record table are checked when the file is opened. Each
+// record's strings carry their own CRC, checked when that record is first read,
+// so opening the file never has to read the whole string table.
+// Newer schema versions may only append fields to records; record sizes in the
+// header let an older layout be read into the current structs.
+
+#define CONFIG_MAGIC 0x43464D48         // "HMFC"
+#define CONFIG_SCHEMA_VERSION 1
+
+#define DEVICE_FLAG_SERPENTINE 0x01
+
+struct __attribute__((packed)) ConfigFileHeader {
+    uint32_t magic;
+    uint16_t schemaVersion;
+    uint16_t headerSize;
+    uint16_t deviceCount;
+    uint16_t networkCount;
+    uint16_t deviceRecordSize;
+    uint16_t networkRecordSize;
+    uint32_t stringsOffset;
+    uint32_t stringsSize;
+    uint32_t recordsCrc;        // CRC32 of all device and network records
+    uint32_t headerCrc;         // CRC32 of the header up to this field
+};
+
+struct __attribute__((packed)) StringRef {
+    uint32_t offset;            // Into the string table
+    uint16_t length;
+};
+
+struct __attribute__((packed)) DeviceRecord {
+    StringRef name;
+    StringRef type;
+    StringRef ledType;
+    StringRef macAddress;
+    StringRef extra;
+    uint16_t numLeds;
+    int16_t dataPin;
+    uint16_t powerBudgetMa;
+    uint16_t matrixWidth;
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t stringsCrc;        // CRC32 of this record's strings, in field order
+};
+
+struct __attribute__((packed)) NetworkRecord {
+    StringRef ssid;
+    StringRef password;
+    uint32_t stringsCrc;
+};
+
+// Changes since the last snapshot are appended to /config.log:
+//
+//   JournalFileHeader
+//   { JournalRecordHeader, JSON payload (length bytes), CRC32 } ...
+//
+// baseCrc is the headerCrc of the /config.bin the journal applies to, so a
+// journal left behind by an interrupted compaction is recognised as stale.
+// Replay stops at the first short or corrupt record (a torn append).
+
+#define JOURNAL_MAGIC 0x4A464D48        // "HMFJ"
+#define JOURNAL_MAX_RECORD 2048
+
+enum JournalOp : uint8_t {
+    JOURNAL_DEVICE_SET = 1,             // {"key": name, "device": {...}}; appended if key is unknown
+    JOURNAL_DEVICE_REMOVE,              // {"key": name}
+    JOURNAL_NETWORK_SET,                // {"key": ssid, "ssid": ..., "password": ...}
+    JOURNAL_NETWORK_REMOVE              // {"key": ssid}
+};
+
+struct __attribute__((packed)) JournalFileHeader {
+    uint32_t magic;
+    uint32_t baseCrc;
+};
+
+struct __attribute__((packed)) JournalRecordHeader {
+    uint8_t op;
+    uint8_t reserved;
+    uint16_t length;                    // Payload bytes; a CRC32 of header + payload follows
+};
+
+uint32_t configCrc32(const void* data, size_t length, uint32_t crc = 0);
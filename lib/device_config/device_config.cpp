@@ -1,23 +1,39 @@
 #include "device_config.h"
+#include "storage_benchmark.h"
+#include "profiler.h"
+#include <stddef.h>
 
+const char* PersistentStorage::CONFIG_BIN_FILE = "/config.bin";
+const char* PersistentStorage::CONFIG_TMP_FILE = "/config.tmp";
+const char* PersistentStorage::CONFIG_JOURNAL_FILE = "/config.log";
 const char* PersistentStorage::CONFIG_FILE = "/config.json";
+const char* PersistentStorage::CONFIG_JSON_BACKUP = "/config.json.bak";
 
-JsonDocument PersistentStorage::loadData() {
+// Adds the lifetime of the enclosing scope to a flash time counter
+struct FlashTimer {
+    uint64_t& total;
+    unsigned long start;
+    FlashTimer(uint64_t& total) : total(total), start(micros()) {}
+    ~FlashTimer() { total += micros() - start; }
+};
+
+JsonDocument PersistentStorage::loadData(const char* path) {
+    PROFILE_SCOPE(ProfileStage::STORAGE);
+    FlashTimer timer(stats.flashUs);
     JsonDocument doc;
-    if (!SPIFFS.exists(CONFIG_FILE)) {
-        doc["devices"].to<JsonArray>();
-        doc["networks"].to<JsonArray>();
-        return doc;
-    }
-    File file = SPIFFS.open(CONFIG_FILE, "r");
-    if (!file) {
+    std::vector<uint8_t> text(backend.size(path));
+    if (text.empty() || backend.read(path, 0, text.data(), text.size()) != text.size()) {
         Serial.println("Failed to open config file for reading");
         doc["devices"].to<JsonArray>();
         doc["networks"].to<JsonArray>();
         return doc;
     }
-    DeserializationError error = deserializeJson(doc, file);
-    file.close();
+    stats.bytesRead += text.size();
+    DeserializationError error;
+    {
+        PROFILE_SCOPE(ProfileStage::JSON_PARSE);
+        error = deserializeJson(doc, (const char*)text.data(), text.size());
+    }
     if (error) {
         Serial.println("Failed to parse config file");
         doc.clear();
@@ -27,52 +43,791 @@ JsonDocument PersistentStorage::loadData() {
     return doc;
 }
 
-bool PersistentStorage::saveData(const JsonDocument& doc) {
-    File file = SPIFFS.open(CONFIG_FILE, "w");
-    if (!file) {
-        Serial.println("Failed to open config file for writing");
+// Keys held in DeviceConfig fields; anything else is kept in DeviceConfig::extra
+static const char* const DEVICE_KEYS[] = {
+    "device_name", "device_type", "led_type", "num_of_leds", "mac_address",
+    "data_pin", "power_budget_ma", "matrix_width", "serpentine"
+};
+
+DeviceConfig PersistentStorage::deviceFromJson(JsonObjectConst object) {
+    DeviceConfig device;
+    device.name = object["device_name"] | "";
+    device.type = object["device_type"] | "strip";
+    device.ledType = object["led_type"] | "WS2812B";
+    device.numLeds = object["num_of_leds"] | 30;
+    device.macAddress = object["mac_address"] | "";
+    device.dataPin = object["data_pin"].is<int>() ? object["data_pin"].as<int>() : -1;
+    device.powerBudgetMa = object["power_budget_ma"] | 0;
+    device.matrixWidth = object["matrix_width"] | 0;
+    device.serpentine = object["serpentine"] | true;
+    
+    JsonDocument extra;
+    for (JsonPairConst pair : object) {
+        bool known = false;
+        for (const char* key : DEVICE_KEYS) {
+            if (pair.key() == key) {
+                known = true;
+                break;
+            }
+        }
+        if (!known) extra[pair.key()] = pair.value();
+    }
+    if (extra.size() > 0) {
+        serializeJson(extra, device.extra);
+    }
+    return device;
+}
+
+void PersistentStorage::deviceToJson(const DeviceConfig& device, JsonObject object) {
+    object["device_name"] = device.name;
+    object["device_type"] = device.type;
+    object["led_type"] = device.ledType;
+    object["num_of_leds"] = device.numLeds;
+    object["mac_address"] = device.macAddress;
+    if (device.dataPin >= 0) object["data_pin"] = device.dataPin;
+    object["power_budget_ma"] = device.powerBudgetMa;
+    if (device.matrixWidth > 0) object["matrix_width"] = device.matrixWidth;
+    if (device.matrixWidth > 0 || !device.serpentine) object["serpentine"] = device.serpentine;
+    
+    if (device.extra.length() > 0) {
+        JsonDocument extra;
+        if (!deserializeJson(extra, device.extra)) {
+            for (JsonPairConst pair : extra.as<JsonObjectConst>()) {
+                object[pair.key()] = pair.value();
+            }
+        }
+    }
+}
+
+void PersistentStorage::resetCache() {
+    devices.clear();
+    networks.clear();
+    deviceRecords.clear();
+    networkRecords.clear();
+    deviceLoaded.clear();
+    allDevicesLoaded = true;
+    networksLoaded = true;
+    stringsOffset = 0;
+    stringsSize = 0;
+    snapshotCrc = 0;
+    pendingJournal.clear();
+    deviceIndexValid = false;
+    networkIndexValid = false;
+}
+
+void PersistentStorage::loadJsonCache(const char* path) {
+    JsonDocument doc = loadData(path);
+    resetCache();
+    for (JsonObjectConst device : doc["devices"].as<JsonArrayConst>()) {
+        setDevice(-1, deviceFromJson(device));
+    }
+    for (JsonObjectConst network : doc["networks"].as<JsonArrayConst>()) {
+        NetworkConfig config;
+        config.ssid = network["ssid"] | "";
+        config.password = network["password"] | "";
+        networks.push_back(config);
+    }
+}
+
+// Reads and checks the header and record table; strings stay on flash
+bool PersistentStorage::openBinary() {
+    PROFILE_SCOPE(ProfileStage::STORAGE);
+    FlashTimer timer(stats.flashUs);
+    resetCache();
+    if (!backend.exists(CONFIG_BIN_FILE)) return false;
+    
+    ConfigFileHeader header;
+    if (backend.read(CONFIG_BIN_FILE, 0, (uint8_t*)&header, sizeof(header)) != sizeof(header) ||
+        header.magic != CONFIG_MAGIC ||
+        header.headerSize != sizeof(header) ||
+        header.headerCrc != configCrc32(&header, offsetof(ConfigFileHeader, headerCrc))) {
+        Serial.println("Config file header is invalid");
         return false;
     }
-    if (serializeJson(doc, file) == 0) {
+    // Newer schemas only append record fields, so the file still reads; writing
+    // it back in this layout would drop them, so it is left alone
+    if (header.schemaVersion > CONFIG_SCHEMA_VERSION) {
+        Serial.println("Config schema v" + String(header.schemaVersion) + " is newer than this firmware, opening read-only");
+        readOnly = true;
+    }
+    
+    size_t deviceBytes = (size_t)header.deviceCount * header.deviceRecordSize;
+    size_t networkBytes = (size_t)header.networkCount * header.networkRecordSize;
+    std::vector<uint8_t> table(deviceBytes + networkBytes);
+    if (backend.read(CONFIG_BIN_FILE, sizeof(header), table.data(), table.size()) != table.size() ||
+        header.recordsCrc != configCrc32(table.data(), table.size())) {
+        Serial.println("Config record table failed its checksum");
+        return false;
+    }
+    stats.bytesRead += sizeof(header) + table.size();
+    
+    // Older schemas have shorter records; fields they lack stay zero
+    deviceRecords.assign(header.deviceCount, DeviceRecord{});
+    for (size_t i = 0; i < header.deviceCount; i++) {
+        memcpy(&deviceRecords[i], table.data() + i * header.deviceRecordSize,
+               min((size_t)header.deviceRecordSize, sizeof(DeviceRecord)));
+    }
+    networkRecords.assign(header.networkCount, NetworkRecord{});
+    for (size_t i = 0; i < header.networkCount; i++) {
+        memcpy(&networkRecords[i], table.data() + deviceBytes + i * header.networkRecordSize,
+               min((size_t)header.networkRecordSize, sizeof(NetworkRecord)));
+    }
+    
+    devices.resize(header.deviceCount);
+    deviceLoaded.assign(header.deviceCount, false);
+    allDevicesLoaded = header.deviceCount == 0;
+    networks.resize(header.networkCount);
+    networksLoaded = header.networkCount == 0;
+    stringsOffset = header.stringsOffset;
+    stringsSize = header.stringsSize;
+    fileSchemaVersion = header.schemaVersion;
+    snapshotCrc = header.headerCrc;
+    return true;
+}
+
+String PersistentStorage::readString(const StringRef& ref, uint32_t& crc) {
+    if (ref.length == 0 || ref.offset + ref.length > stringsSize) return "";
+    FlashTimer timer(stats.flashUs);
+    char* buffer = new char[ref.length + 1];
+    size_t length = backend.read(CONFIG_BIN_FILE, stringsOffset + ref.offset, (uint8_t*)buffer, ref.length);
+    buffer[length] = '\0';
+    stats.bytesRead += length;
+    crc = configCrc32(buffer, length, crc);
+    String value(buffer);
+    delete[] buffer;
+    return value;
+}
+
+DeviceConfig& PersistentStorage::deviceAt(size_t index) {
+    DeviceConfig& device = devices[index];
+    if (allDevicesLoaded || deviceLoaded[index]) return device;
+    PROFILE_SCOPE(ProfileStage::STORAGE);
+    
+    const DeviceRecord& record = deviceRecords[index];
+    uint32_t crc = 0;
+    device.name = readString(record.name, crc);
+    device.type = readString(record.type, crc);
+    device.ledType = readString(record.ledType, crc);
+    device.macAddress = readString(record.macAddress, crc);
+    device.extra = readString(record.extra, crc);
+    if (crc != record.stringsCrc) {
+        Serial.println("Config device " + String(index) + " failed its checksum");
+        device.name = "";
+        device.type = "strip";
+        device.ledType = "WS2812B";
+        device.macAddress = "";
+        device.extra = "";
+    }
+    device.numLeds = record.numLeds;
+    device.dataPin = record.dataPin;
+    device.powerBudgetMa = record.powerBudgetMa;
+    device.matrixWidth = record.matrixWidth;
+    device.serpentine = record.flags & DEVICE_FLAG_SERPENTINE;
+    deviceLoaded[index] = true;
+    return device;
+}
+
+void PersistentStorage::loadAllDevices() {
+    if (allDevicesLoaded) return;
+    for (size_t i = 0; i < deviceLoaded.size(); i++) {
+        deviceAt(i);
+    }
+    allDevicesLoaded = true;
+}
+
+void PersistentStorage::loadNetworks() {
+    if (networksLoaded) return;
+    PROFILE_SCOPE(ProfileStage::STORAGE);
+    for (size_t i = 0; i < networkRecords.size(); i++) {
+        uint32_t crc = 0;
+        networks[i].ssid = readString(networkRecords[i].ssid, crc);
+        networks[i].password = readString(networkRecords[i].password, crc);
+        if (crc != networkRecords[i].stringsCrc) {
+            Serial.println("Config network " + String(i) + " failed its checksum");
+            networks[i] = NetworkConfig();
+        }
+    }
+    networksLoaded = true;
+}
+
+// Writes the whole cache as a new /config.bin; the cache is untouched on failure.
+// The file is written beside the old one and renamed over it, so a power cut
+// leaves either the old or the new snapshot (begin() finishes the rename).
+bool PersistentStorage::writeBinary() {
+    PROFILE_SCOPE(ProfileStage::STORAGE);
+    loadAllDevices();
+    loadNetworks();
+    
+    String strings;
+    auto addString = [&strings](const String& value, uint32_t& crc) {
+        StringRef ref = { (uint32_t)strings.length(), (uint16_t)value.length() };
+        strings += value;
+        crc = configCrc32(value.c_str(), value.length(), crc);
+        return ref;
+    };
+    
+    std::vector<DeviceRecord> newDeviceRecords(devices.size());
+    for (size_t i = 0; i < devices.size(); i++) {
+        const DeviceConfig& device = devices[i];
+        DeviceRecord& record = newDeviceRecords[i];
+        uint32_t crc = 0;
+        record.name = addString(device.name, crc);
+        record.type = addString(device.type, crc);
+        record.ledType = addString(device.ledType, crc);
+        record.macAddress = addString(device.macAddress, crc);
+        record.extra = addString(device.extra, crc);
+        record.numLeds = device.numLeds;
+        record.dataPin = device.dataPin;
+        record.powerBudgetMa = device.powerBudgetMa;
+        record.matrixWidth = device.matrixWidth;
+        record.flags = device.serpentine ? DEVICE_FLAG_SERPENTINE : 0;
+        record.stringsCrc = crc;
+    }
+    std::vector<NetworkRecord> newNetworkRecords(networks.size());
+    for (size_t i = 0; i < networks.size(); i++) {
+        uint32_t crc = 0;
+        newNetworkRecords[i].ssid = addString(networks[i].ssid, crc);
+        newNetworkRecords[i].password = addString(networks[i].password, crc);
+        newNetworkRecords[i].stringsCrc = crc;
+    }
+    
+    size_t deviceBytes = newDeviceRecords.size() * sizeof(DeviceRecord);
+    size_t networkBytes = newNetworkRecords.size() * sizeof(NetworkRecord);
+    ConfigFileHeader header = {};
+    header.magic = CONFIG_MAGIC;
+    header.schemaVersion = CONFIG_SCHEMA_VERSION;
+    header.headerSize = sizeof(ConfigFileHeader);
+    header.deviceCount = newDeviceRecords.size();
+    header.networkCount = newNetworkRecords.size();
+    header.deviceRecordSize = sizeof(DeviceRecord);
+    header.networkRecordSize = sizeof(NetworkRecord);
+    header.stringsOffset = sizeof(ConfigFileHeader) + deviceBytes + networkBytes;
+    header.stringsSize = strings.length();
+    header.recordsCrc = configCrc32(newDeviceRecords.data(), deviceBytes);
+    header.recordsCrc = configCrc32(newNetworkRecords.data(), networkBytes, header.recordsCrc);
+    header.headerCrc = configCrc32(&header, offsetof(ConfigFileHeader, headerCrc));
+    
+    std::vector<uint8_t> image;
+    image.reserve(header.stringsOffset + header.stringsSize);
+    const uint8_t* headerBytes = (const uint8_t*)&header;
+    const uint8_t* deviceRecordBytes = (const uint8_t*)newDeviceRecords.data();
+    const uint8_t* networkRecordBytes = (const uint8_t*)newNetworkRecords.data();
+    const uint8_t* stringBytes = (const uint8_t*)strings.c_str();
+    image.insert(image.end(), headerBytes, headerBytes + sizeof(header));
+    image.insert(image.end(), deviceRecordBytes, deviceRecordBytes + deviceBytes);
+    image.insert(image.end(), networkRecordBytes, networkRecordBytes + networkBytes);
+    image.insert(image.end(), stringBytes, stringBytes + strings.length());
+    
+    FlashTimer timer(stats.flashUs);
+    if (!backend.write(CONFIG_TMP_FILE, image.data(), image.size())) {
         Serial.println("Failed to write to config file");
-        file.close();
+        backend.remove(CONFIG_TMP_FILE);
         return false;
     }
-    file.close();
+    stats.bytesWritten += image.size();
+    if (!backend.rename(CONFIG_TMP_FILE, CONFIG_BIN_FILE)) {
+        Serial.println("Failed to replace config file");
+        return false;
+    }
+    
+    deviceRecords.swap(newDeviceRecords);
+    networkRecords.swap(newNetworkRecords);
+    deviceLoaded.assign(devices.size(), true);
+    stringsOffset = header.stringsOffset;
+    stringsSize = header.stringsSize;
+    fileSchemaVersion = CONFIG_SCHEMA_VERSION;
+    snapshotCrc = header.headerCrc;
     return true;
 }
 
-bool PersistentStorage::begin() {
-    if (!SPIFFS.begin(true)) {
-        Serial.println("SPIFFS Mount Failed");
+// Applies /config.log on top of the snapshot. Replay needs every record
+// decoded, so boot is only fully lazy right after a compaction.
+void PersistentStorage::replayJournal() {
+    journalSize = 0;
+    if (!backend.exists(CONFIG_JOURNAL_FILE)) return;
+    PROFILE_SCOPE(ProfileStage::STORAGE);
+    
+    // The journal stays under a few KB (see JOURNAL_COMPACT_BYTES), so read it whole
+    std::vector<uint8_t> log(backend.size(CONFIG_JOURNAL_FILE));
+    {
+        FlashTimer timer(stats.flashUs);
+        log.resize(backend.read(CONFIG_JOURNAL_FILE, 0, log.data(), log.size()));
+    }
+    stats.bytesRead += log.size();
+    JournalFileHeader header = {};
+    if (log.size() >= sizeof(header)) memcpy(&header, log.data(), sizeof(header));
+    if (header.magic != JOURNAL_MAGIC || header.baseCrc != snapshotCrc) {
+        Serial.println("Discarding stale config journal");
+        if (!readOnly) backend.remove(CONFIG_JOURNAL_FILE);
+        return;
+    }
+    
+    loadAllDevices();
+    loadNetworks();
+    int replayed = 0;
+    size_t valid = sizeof(header) +
+                   applyJournalRecords(log.data() + sizeof(header), log.size() - sizeof(header), replayed);
+    journalSize = valid;
+    Serial.println("Replayed " + String(replayed) + " config changes from journal");
+    
+    // Records after a torn append would never be reached; start a fresh journal
+    if (valid < log.size() && !readOnly) {
+        Serial.println("Config journal has a damaged tail, compacting");
+        compact();
+    }
+}
+
+// Applies records up to the first short or corrupt one; returns the bytes used
+size_t PersistentStorage::applyJournalRecords(const uint8_t* data, size_t length, int& applied) {
+    size_t valid = 0;
+    JournalRecordHeader record;
+    uint32_t storedCrc;
+    while (valid + sizeof(record) <= length) {
+        memcpy(&record, data + valid, sizeof(record));
+        const char* payload = (const char*)data + valid + sizeof(record);
+        size_t end = valid + sizeof(record) + record.length + sizeof(storedCrc);
+        if (record.length > JOURNAL_MAX_RECORD || end > length) break;
+        memcpy(&storedCrc, data + end - sizeof(storedCrc), sizeof(storedCrc));
+        uint32_t crc = configCrc32(&record, sizeof(record));
+        if (configCrc32(payload, record.length, crc) != storedCrc) break;
+        JsonDocument doc;
+        if (!deserializeJson(doc, payload, record.length)) {
+            applyJournalRecord(record.op, doc.as<JsonObjectConst>());
+        }
+        valid = end;
+        applied++;
+    }
+    return valid;
+}
+
+void PersistentStorage::applyJournalRecord(uint8_t op, JsonObjectConst payload) {
+    String key = payload["key"] | "";
+    switch (op) {
+        case JOURNAL_DEVICE_SET:
+            // A record setDevice() refuses is skipped, as it was when first made
+            setDevice(deviceIndexOf(key), deviceFromJson(payload["device"]));
+            break;
+        case JOURNAL_DEVICE_REMOVE:
+            eraseDevice(key);
+            break;
+        case JOURNAL_NETWORK_SET: {
+            NetworkConfig network;
+            network.ssid = payload["ssid"] | "";
+            network.password = payload["password"] | "";
+            setNetwork(networkIndexOf(key), network);
+            break;
+        }
+        case JOURNAL_NETWORK_REMOVE:
+            eraseNetwork(key);
+            break;
+        default:
+            Serial.println("Unknown config journal op " + String(op));
+            break;
+    }
+}
+
+// Queues one record for the next flush. Once the queue alone is past the
+// compaction size a snapshot is cheaper, so the queue is dropped for one.
+void PersistentStorage::journal(uint8_t op, const JsonDocument& payload) {
+    if (needsSnapshot || readOnly) return;
+    String json;
+    serializeJson(payload, json);
+    if (json.length() > JOURNAL_MAX_RECORD ||
+        pendingJournal.size() + json.length() > JOURNAL_COMPACT_BYTES) {
+        needsSnapshot = true;
+        pendingJournal.clear();
+        return;
+    }
+    JournalRecordHeader record = { op, 0, (uint16_t)json.length() };
+    uint32_t crc = configCrc32(&record, sizeof(record));
+    crc = configCrc32(json.c_str(), json.length(), crc);
+    const uint8_t* recordBytes = (const uint8_t*)&record;
+    const uint8_t* jsonBytes = (const uint8_t*)json.c_str();
+    const uint8_t* crcBytes = (const uint8_t*)&crc;
+    pendingJournal.insert(pendingJournal.end(), recordBytes, recordBytes + sizeof(record));
+    pendingJournal.insert(pendingJournal.end(), jsonBytes, jsonBytes + json.length());
+    pendingJournal.insert(pendingJournal.end(), crcBytes, crcBytes + sizeof(crc));
+}
+
+void PersistentStorage::journalDevice(const String& key, const DeviceConfig& device) {
+    JsonDocument doc;
+    doc["key"] = key;
+    deviceToJson(device, doc["device"].to<JsonObject>());
+    journal(JOURNAL_DEVICE_SET, doc);
+}
+
+void PersistentStorage::journalNetwork(const String& key, const NetworkConfig& network) {
+    JsonDocument doc;
+    doc["key"] = key;
+    doc["ssid"] = network.ssid;
+    doc["password"] = network.password;
+    journal(JOURNAL_NETWORK_SET, doc);
+}
+
+void PersistentStorage::journalRemove(uint8_t op, const String& key) {
+    JsonDocument doc;
+    doc["key"] = key;
+    journal(op, doc);
+}
+
+bool PersistentStorage::appendJournal() {
+    if (pendingJournal.empty()) return true;
+    PROFILE_SCOPE(ProfileStage::STORAGE);
+    FlashTimer timer(stats.flashUs);
+    bool ok;
+    size_t written = pendingJournal.size();
+    if (journalSize == 0) {
+        // New journal: replaces any stale one
+        JournalFileHeader header = { JOURNAL_MAGIC, snapshotCrc };
+        const uint8_t* headerBytes = (const uint8_t*)&header;
+        pendingJournal.insert(pendingJournal.begin(), headerBytes, headerBytes + sizeof(header));
+        written = pendingJournal.size();
+        ok = backend.write(CONFIG_JOURNAL_FILE, pendingJournal.data(), written);
+    } else {
+        ok = backend.append(CONFIG_JOURNAL_FILE, pendingJournal.data(), written);
+    }
+    if (!ok) {
+        Serial.println("Failed to append to config journal");
         return false;
     }
-    Serial.println("SPIFFS mounted successfully");
-    if (!SPIFFS.exists(CONFIG_FILE)) {
-        Serial.println("Config file not found, creating with default data");
-        initializeDefaultData();
+    stats.bytesWritten += written;
+    journalSize += written;
+    pendingJournal.clear();
+    stats.journalAppends++;
+    return true;
+}
+
+// Folds the journal into a new snapshot
+bool PersistentStorage::compact() {
+    if (readOnly || !writeBinary()) return false;
+    {
+        FlashTimer timer(stats.flashUs);
+        backend.remove(CONFIG_JOURNAL_FILE);
     }
+    journalSize = 0;
+    pendingJournal.clear();
+    needsSnapshot = false;
+    stats.compactions++;
     return true;
 }
 
-bool PersistentStorage::initializeDefaultData() {
+JsonDocument PersistentStorage::toDocument() {
+    loadAllDevices();
+    loadNetworks();
     JsonDocument doc;
-    JsonArray devices = doc["devices"].to<JsonArray>();
+    JsonArray deviceArray = doc["devices"].to<JsonArray>();
+    for (const DeviceConfig& device : devices) {
+        deviceToJson(device, deviceArray.add<JsonObject>());
+    }
+    JsonArray networkArray = doc["networks"].to<JsonArray>();
+    for (const NetworkConfig& network : networks) {
+        JsonObject object = networkArray.add<JsonObject>();
+        object["ssid"] = network.ssid;
+        object["password"] = network.password;
+    }
+    return doc;
+}
+
+// Records a change to the cache; it reaches flash later through loop() or flush()
+bool PersistentStorage::commit() {
+    if (readOnly) {
+        Serial.println("Config is read-only, change kept until restart");
+        return false;
+    }
+    stats.mutations++;
+    if (!dirty) firstChangeMs = millis();
+    lastChangeMs = millis();
+    dirty = true;
+    return true;
+}
+
+// Writes the cache if it has changed. On failure the cache stays dirty (it is
+// still the newest copy) and loop() tries again after the debounce interval.
+// A failed append may leave a torn record, so it falls back to a snapshot.
+bool PersistentStorage::flush() {
+    if (!dirty) return true;
+    if (transactionDepth > 0) transactionUndoable = false;     // Flash now holds part of it
+    if (!needsSnapshot && !appendJournal()) needsSnapshot = true;
+    if (needsSnapshot && !compact()) {
+        stats.failedFlushes++;
+        firstChangeMs = lastChangeMs = millis();
+        return false;
+    }
+    stats.flushes++;
+    dirty = false;
+    return true;
+}
+
+void PersistentStorage::loop() {
+    if (transactionDepth > 0 || readOnly || !ready) return;
+    unsigned long now = millis();
+    if (dirty) {
+        if (now - lastChangeMs >= FLUSH_DEBOUNCE_MS || now - firstChangeMs >= FLUSH_MAX_DELAY_MS) {
+            flush();
+        }
+    } else if (journalSize > JOURNAL_COMPACT_BYTES && now - lastChangeMs >= FLUSH_DEBOUNCE_MS) {
+        if (!compact()) lastChangeMs = now;     // Retry after another debounce interval
+    }
+}
+
+// Transactions nest; loop() does not flush until the outermost one commits,
+// so a batch of changes is never written half-applied. The outermost one
+// remembers the queued journal records so a rollback can rebuild the cache
+// from flash plus those records. A pending whole-config rewrite has no
+// records, so it is flushed first.
+void PersistentStorage::beginTransaction() {
+    if (transactionDepth++ > 0) return;
+    if (dirty && needsSnapshot) flush();
+    transactionUndoable = !needsSnapshot;
+    transactionBase = pendingJournal;
+    transactionBaseDirty = dirty;
+}
+
+bool PersistentStorage::commitTransaction() {
+    if (transactionDepth > 0) transactionDepth--;
+    if (transactionDepth == 0) transactionBase.clear();
+    return true;
+}
+
+// False (the changes stay, as if committed) when the state before the
+// transaction is gone: its snapshot failed to flush, or flush() was called
+// inside the transaction
+bool PersistentStorage::rollbackTransaction() {
+    if (transactionDepth == 0) return false;
+    transactionDepth = 0;
+    if (!transactionUndoable) {
+        Serial.println("Config transaction cannot be rolled back, keeping its changes");
+        transactionBase.clear();
+        return false;
+    }
+    
+    if (openBinary()) {
+        replayJournal();
+    } else {
+        resetCache();
+    }
+    int applied = 0;
+    applyJournalRecords(transactionBase.data(), transactionBase.size(), applied);
+    pendingJournal.swap(transactionBase);
+    transactionBase.clear();
+    needsSnapshot = false;
+    dirty = transactionBaseDirty;
+    Serial.println("Config transaction rolled back");
+    return true;
+}
+
+// Write amplification: flushes and flash bytes per change. With batching both
+// fall well below one write (and one file size) per change.
+void PersistentStorage::reportStats(JsonObject out) const {
+    out["mutations"] = stats.mutations;
+    out["flushes"] = stats.flushes;
+    out["failed_flushes"] = stats.failedFlushes;
+    out["bytes_written"] = stats.bytesWritten;
+    out["bytes_read"] = stats.bytesRead;
+    out["journal_appends"] = stats.journalAppends;
+    out["compactions"] = stats.compactions;
+    out["journal_bytes"] = journalSize;
+    out["flash_ms"] = (uint32_t)(stats.flashUs / 1000);
+    out["writes_per_mutation"] = stats.mutations ? (float)stats.flushes / stats.mutations : 0.0f;
+    out["bytes_per_mutation"] = stats.mutations ? stats.bytesWritten / stats.mutations : 0;
+    out["pending"] = dirty;
+    out["ready"] = ready;
+    out["read_only"] = readOnly;
+}
+
+int PersistentStorage::deviceIndexOf(const String& deviceName) {
+    loadAllDevices();
+    if (!deviceIndexValid) {
+        deviceNameIndex.clear();
+        deviceMacIndex.clear();
+        for (size_t i = 0; i < devices.size(); i++) {
+            deviceNameIndex.add(devices[i].name, i);
+            deviceMacIndex.add(devices[i].macAddress, i);
+        }
+        deviceIndexValid = true;
+    }
+    return deviceNameIndex.find(deviceName, [this](size_t i) -> const String& { return devices[i].name; });
+}
+
+int PersistentStorage::deviceIndexOfMac(const String& macAddress) {
+    deviceIndexOf("");      // Builds both device indexes
+    return deviceMacIndex.find(macAddress, [this](size_t i) -> const String& { return devices[i].macAddress; });
+}
+
+int PersistentStorage::networkIndexOf(const String& ssid) {
+    loadNetworks();
+    if (!networkIndexValid) {
+        networkSsidIndex.clear();
+        for (size_t i = 0; i < networks.size(); i++) {
+            networkSsidIndex.add(networks[i].ssid, i);
+        }
+        networkIndexValid = true;
+    }
+    return networkSsidIndex.find(ssid, [this](size_t i) -> const String& { return networks[i].ssid; });
+}
+
+// DeviceRecord keeps the numbers and string lengths in 16 bits; anything
+// wider is refused rather than silently truncated in the next snapshot
+static bool deviceFitsRecord(const DeviceConfig& device) {
+    const char* field = nullptr;
+    if (device.numLeds < 0 || device.numLeds > UINT16_MAX) field = "num_of_leds";
+    else if (device.dataPin < -1 || device.dataPin > INT16_MAX) field = "data_pin";
+    else if (device.powerBudgetMa < 0 || device.powerBudgetMa > UINT16_MAX) field = "power_budget_ma";
+    else if (device.matrixWidth < 0 || device.matrixWidth > UINT16_MAX) field = "matrix_width";
+    else if (device.name.length() > UINT16_MAX || device.type.length() > UINT16_MAX ||
+             device.ledType.length() > UINT16_MAX || device.macAddress.length() > UINT16_MAX ||
+             device.extra.length() > UINT16_MAX) field = "string length";
+    if (field) {
+        Serial.println("Device " + device.name + ": " + field + " out of range");
+        return false;
+    }
+    return true;
+}
+
+// Replaces entry `index`, or appends when it is -1. False if the device
+// cannot be stored.
+bool PersistentStorage::setDevice(int index, const DeviceConfig& device) {
+    if (!deviceFitsRecord(device)) return false;
+    if (index < 0) {
+        devices.push_back(device);
+        if (deviceIndexValid) {
+            deviceNameIndex.add(device.name, devices.size() - 1);
+            deviceMacIndex.add(device.macAddress, devices.size() - 1);
+        }
+        return true;
+    }
+    if (deviceIndexValid && devices[index].name != device.name) {
+        deviceNameIndex.remove(devices[index].name, index);
+        deviceNameIndex.add(device.name, index);
+    }
+    if (deviceIndexValid && devices[index].macAddress != device.macAddress) {
+        deviceMacIndex.remove(devices[index].macAddress, index);
+        deviceMacIndex.add(device.macAddress, index);
+    }
+    devices[index] = device;
+    return true;
+}
+
+void PersistentStorage::setNetwork(int index, const NetworkConfig& network) {
+    if (index < 0) {
+        networks.push_back(network);
+        if (networkIndexValid) networkSsidIndex.add(network.ssid, networks.size() - 1);
+        return;
+    }
+    if (networkIndexValid && networks[index].ssid != network.ssid) {
+        networkSsidIndex.remove(networks[index].ssid, index);
+        networkSsidIndex.add(network.ssid, index);
+    }
+    networks[index] = network;
+}
+
+// Erasing shifts every later position down one; the indexes follow in place
+bool PersistentStorage::eraseDevice(const String& deviceName) {
+    int index = deviceIndexOf(deviceName);
+    if (index < 0) return false;
+    deviceNameIndex.erase(devices[index].name, index);
+    deviceMacIndex.erase(devices[index].macAddress, index);
+    devices.erase(devices.begin() + index);
+    return true;
+}
+
+bool PersistentStorage::eraseNetwork(const String& ssid) {
+    int index = networkIndexOf(ssid);
+    if (index < 0) return false;
+    networkSsidIndex.erase(networks[index].ssid, index);
+    networks.erase(networks.begin() + index);
+    return true;
+}
+
+DeviceConfig* PersistentStorage::findDevice(const String& deviceName) {
+    int index = deviceIndexOf(deviceName);
+    return index >= 0 ? &devices[index] : nullptr;
+}
+
+NetworkConfig* PersistentStorage::findNetwork(const String& ssid) {
+    int index = networkIndexOf(ssid);
+    return index >= 0 ? &networks[index] : nullptr;
+}
+
+bool PersistentStorage::begin() {
+    ready = open();
+    return ready;
+}
+
+bool PersistentStorage::open() {
+    if (!backend.begin()) {
+        return false;
+    }
+    
+    // A compaction interrupted between removing the old snapshot and renaming
+    // the new one leaves only the (complete) temp file
+    if (backend.exists(CONFIG_TMP_FILE)) {
+        if (!backend.exists(CONFIG_BIN_FILE)) {
+            backend.rename(CONFIG_TMP_FILE, CONFIG_BIN_FILE);
+        } else {
+            backend.remove(CONFIG_TMP_FILE);
+        }
+    }
+    
+    readOnly = false;
+    if (openBinary()) {
+        replayJournal();
+        if (fileSchemaVersion < CONFIG_SCHEMA_VERSION) {
+            Serial.println("Upgrading config from schema v" + String(fileSchemaVersion));
+            needsSnapshot = true;
+            commit();
+        }
+        return true;
+    }
+    // A damaged file from newer firmware is still not ours to replace
+    if (readOnly) {
+        Serial.println("Config from newer firmware is damaged, leaving it in place");
+        return false;
+    }
+    
+    // No usable binary config: migrate the JSON one (or its backup if the
+    // binary file was damaged after a migration)
+    const char* jsonPath = backend.exists(CONFIG_FILE) ? CONFIG_FILE :
+                           backend.exists(CONFIG_JSON_BACKUP) ? CONFIG_JSON_BACKUP : nullptr;
+    if (jsonPath) {
+        Serial.println("Migrating " + String(jsonPath) + " to " + CONFIG_BIN_FILE);
+        loadJsonCache(jsonPath);
+        backend.remove(CONFIG_JOURNAL_FILE);
+        if (!compact()) {
+            Serial.println("Failed to write binary config, using JSON config for this boot");
+            needsSnapshot = true;
+            return true;
+        }
+        if (jsonPath == CONFIG_FILE) {
+            backend.rename(CONFIG_FILE, CONFIG_JSON_BACKUP);
+        }
+        return true;
+    }
+    Serial.println("Config file not found, creating with default data");
+    return initializeDefaultData();
+}
+
+bool PersistentStorage::initializeDefaultData() {
+    resetCache();
     
     // Add default device with dynamic MAC address
-    JsonObject device1 = devices.add<JsonObject>();
-    device1["device_name"] = "LEDStrip1";
-    device1["device_type"] = "strip";
-    device1["led_type"] = "WS2812B";
-    device1["num_of_leds"] = 30;
-    device1["mac_address"] = getDeviceMacAddress();
-    
-    JsonArray networks = doc["networks"].to<JsonArray>();
-    JsonObject network1 = networks.add<JsonObject>();
-    network1["ssid"] = "HomeNetwork";
-    network1["password"] = "password123";
-    
-    if (saveData(doc)) {
+    DeviceConfig device1;
+    device1.name = "LEDStrip1";
+    device1.type = "strip";
+    device1.ledType = "WS2812B";
+    device1.numLeds = 30;
+    device1.macAddress = getDeviceMacAddress();
+    device1.powerBudgetMa = 0; // 0 = no current limit
+    devices.push_back(device1);
+    
+    NetworkConfig network1;
+    network1.ssid = "HomeNetwork";
+    network1.password = "password123";
+    networks.push_back(network1);
+    
+    needsSnapshot = true;
+    commit();
+    if (flush()) {
         Serial.println("Default data initialized successfully");
         return true;
     }
@@ -89,21 +844,19 @@ String PersistentStorage::getDeviceMacAddress() {
 
 bool PersistentStorage::addDevice(const String& deviceName, const String& deviceType, 
                const String& ledType, int numLeds, const String& macAddress) {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    for (JsonVariant device : devices) {
-        if (device["device_name"] == deviceName || device["mac_address"] == macAddress) {
-            Serial.println("Device with same name or MAC address already exists");
-            return false;
-        }
+    if (deviceIndexOf(deviceName) >= 0 || deviceIndexOfMac(macAddress) >= 0) {
+        Serial.println("Device with same name or MAC address already exists");
+        return false;
     }
-    JsonObject newDevice = devices.add<JsonObject>();
-    newDevice["device_name"] = deviceName;
-    newDevice["device_type"] = deviceType;
-    newDevice["led_type"] = ledType;
-    newDevice["num_of_leds"] = numLeds;
-    newDevice["mac_address"] = macAddress;
-    if (saveData(doc)) {
+    DeviceConfig newDevice;
+    newDevice.name = deviceName;
+    newDevice.type = deviceType;
+    newDevice.ledType = ledType;
+    newDevice.numLeds = numLeds;
+    newDevice.macAddress = macAddress;
+    if (!setDevice(-1, newDevice)) return false;
+    journalDevice(deviceName, newDevice);
+    if (commit()) {
         Serial.println("Device added: " + deviceName);
         return true;
     }
@@ -111,197 +864,205 @@ bool PersistentStorage::addDevice(const String& deviceName, const String& device
 }
 
 bool PersistentStorage::addNetwork(const String& ssid, const String& password) {
-    JsonDocument doc = loadData();
-    JsonArray networks = doc["networks"];
-    for (JsonVariant network : networks) {
-        if (network["ssid"] == ssid) {
-            Serial.println("Network with same SSID already exists");
-            return false;
-        }
+    if (networkIndexOf(ssid) >= 0) {
+        Serial.println("Network with same SSID already exists");
+        return false;
     }
-    JsonObject newNetwork = networks.add<JsonObject>();
-    newNetwork["ssid"] = ssid;
-    newNetwork["password"] = password;
-    if (saveData(doc)) {
+    NetworkConfig newNetwork;
+    newNetwork.ssid = ssid;
+    newNetwork.password = password;
+    setNetwork(-1, newNetwork);
+    journalNetwork(ssid, newNetwork);
+    if (commit()) {
         Serial.println("Network added: " + ssid);
         return true;
     }
     return false;
 }
 
+// Property updates go through the JSON form so any key, typed or extra, works
+bool PersistentStorage::setDeviceKey(const String& deviceName, const String& key, JsonVariantConst value) {
+    int index = deviceIndexOf(deviceName);
+    if (index < 0) {
+        Serial.println("Device not found: " + deviceName);
+        return false;
+    }
+    JsonDocument doc;
+    JsonObject object = doc.to<JsonObject>();
+    deviceToJson(devices[index], object);
+    object[key] = value;
+    if (!setDevice(index, deviceFromJson(object))) return false;
+    journalDevice(deviceName, devices[index]);
+    return commit();
+}
+
 bool PersistentStorage::updateDeviceProperty(const String& deviceName, const String& key, const String& value) {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    for (JsonVariant device : devices) {
-        if (device["device_name"] == deviceName) {
-            device[key] = value;
-            if (saveData(doc)) {
-                Serial.println("Updated device " + deviceName + " - " + key + ": " + value);
-                return true;
-            }
-            return false;
-        }
+    JsonDocument holder;
+    holder.set(value);
+    if (setDeviceKey(deviceName, key, holder.as<JsonVariantConst>())) {
+        Serial.println("Updated device " + deviceName + " - " + key + ": " + value);
+        return true;
     }
-    Serial.println("Device not found: " + deviceName);
     return false;
 }
 
 bool PersistentStorage::updateDeviceProperty(const String& deviceName, const String& key, int value) {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    for (JsonVariant device : devices) {
-        if (device["device_name"] == deviceName) {
-            device[key] = value;
-            if (saveData(doc)) {
-                Serial.println("Updated device " + deviceName + " - " + key + ": " + String(value));
-                return true;
-            }
-            return false;
-        }
+    JsonDocument holder;
+    holder.set(value);
+    if (setDeviceKey(deviceName, key, holder.as<JsonVariantConst>())) {
+        Serial.println("Updated device " + deviceName + " - " + key + ": " + String(value));
+        return true;
     }
-    Serial.println("Device not found: " + deviceName);
     return false;
 }
 
 bool PersistentStorage::updateNetworkProperty(const String& ssid, const String& key, const String& value) {
-    JsonDocument doc = loadData();
-    JsonArray networks = doc["networks"];
-    for (JsonVariant network : networks) {
-        if (network["ssid"] == ssid) {
-            network[key] = value;
-            if (saveData(doc)) {
-                Serial.println("Updated network " + ssid + " - " + key + ": " + value);
-                return true;
-            }
-            return false;
-        }
+    int index = networkIndexOf(ssid);
+    if (index < 0) {
+        Serial.println("Network not found: " + ssid);
+        return false;
+    }
+    NetworkConfig network = networks[index];
+    if (key == "ssid") {
+        network.ssid = value;
+    } else if (key == "password") {
+        network.password = value;
+    } else {
+        Serial.println("Unknown network property: " + key);
+        return false;
+    }
+    setNetwork(index, network);
+    journalNetwork(ssid, network);
+    if (commit()) {
+        Serial.println("Updated network " + ssid + " - " + key + ": " + value);
+        return true;
     }
-    Serial.println("Network not found: " + ssid);
     return false;
 }
 
 bool PersistentStorage::removeDevice(const String& deviceName) {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    for (int i = 0; i < devices.size(); i++) {
-        if (devices[i]["device_name"] == deviceName) {
-            devices.remove(i);
-            if (saveData(doc)) {
-                Serial.println("Device removed: " + deviceName);
-                return true;
-            }
-            return false;
-        }
+    if (!eraseDevice(deviceName)) {
+        Serial.println("Device not found: " + deviceName);
+        return false;
+    }
+    journalRemove(JOURNAL_DEVICE_REMOVE, deviceName);
+    if (commit()) {
+        Serial.println("Device removed: " + deviceName);
+        return true;
     }
-    Serial.println("Device not found: " + deviceName);
     return false;
 }
 
 bool PersistentStorage::removeNetwork(const String& ssid) {
-    JsonDocument doc = loadData();
-    JsonArray networks = doc["networks"];
-    for (int i = 0; i < networks.size(); i++) {
-        if (networks[i]["ssid"] == ssid) {
-            networks.remove(i);
-            if (saveData(doc)) {
-                Serial.println("Network removed: " + ssid);
-                return true;
-            }
-            return false;
-        }
+    if (!eraseNetwork(ssid)) {
+        Serial.println("Network not found: " + ssid);
+        return false;
+    }
+    journalRemove(JOURNAL_NETWORK_REMOVE, ssid);
+    if (commit()) {
+        Serial.println("Network removed: " + ssid);
+        return true;
     }
-    Serial.println("Network not found: " + ssid);
     return false;
 }
 
 String PersistentStorage::getAllData() {
-    JsonDocument doc = loadData();
     String output;
-    serializeJsonPretty(doc, output);
+    serializeJsonPretty(toDocument(), output);
     return output;
 }
 
 String PersistentStorage::getAllDataCompact() {
-    JsonDocument doc = loadData();
     String output;
-    serializeJson(doc, output);
+    serializeJson(toDocument(), output);
     return output;
 }
 
 String PersistentStorage::getDevice(const String& deviceName) {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    for (JsonVariant device : devices) {
-        if (device["device_name"] == deviceName) {
-            String output;
-            serializeJsonPretty(device, output);
-            return output;
-        }
-    }
-    return "Device not found";
+    DeviceConfig* device = findDevice(deviceName);
+    if (!device) return "Device not found";
+    JsonDocument doc;
+    deviceToJson(*device, doc.to<JsonObject>());
+    String output;
+    serializeJsonPretty(doc, output);
+    return output;
 }
 
 String PersistentStorage::getNetwork(const String& ssid) {
-    JsonDocument doc = loadData();
-    JsonArray networks = doc["networks"];
-    for (JsonVariant network : networks) {
-        if (network["ssid"] == ssid) {
-            String output;
-            serializeJsonPretty(network, output);
-            return output;
-        }
-    }
-    return "Network not found";
+    NetworkConfig* network = findNetwork(ssid);
+    if (!network) return "Network not found";
+    JsonDocument doc;
+    doc["ssid"] = network->ssid;
+    doc["password"] = network->password;
+    String output;
+    serializeJsonPretty(doc, output);
+    return output;
 }
 
 String PersistentStorage::getAllDevices() {
-    JsonDocument doc = loadData();
+    JsonDocument doc = toDocument();
     String output;
     serializeJsonPretty(doc["devices"], output);
     return output;
 }
 
 String PersistentStorage::getAllNetworks() {
-    JsonDocument doc = loadData();
+    JsonDocument doc = toDocument();
     String output;
     serializeJsonPretty(doc["networks"], output);
     return output;
 }
 
 bool PersistentStorage::deviceExists(const String& deviceName) {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    for (JsonVariant device : devices) {
-        if (device["device_name"] == deviceName) {
-            return true;
-        }
-    }
-    return false;
+    return findDevice(deviceName) != nullptr;
 }
 
 bool PersistentStorage::networkExists(const String& ssid) {
-    JsonDocument doc = loadData();
-    JsonArray networks = doc["networks"];
-    for (JsonVariant network : networks) {
-        if (network["ssid"] == ssid) {
-            return true;
-        }
-    }
-    return false;
+    return findNetwork(ssid) != nullptr;
 }
 
 int PersistentStorage::getDeviceCount() {
-    JsonDocument doc = loadData();
-    return doc["devices"].size();
+    return devices.size();
 }
 
 int PersistentStorage::getNetworkCount() {
-    JsonDocument doc = loadData();
-    return doc["networks"].size();
+    return networks.size();
+}
+
+const DeviceConfig& PersistentStorage::getDeviceConfig(int index) {
+    return deviceAt(index);
+}
+
+int PersistentStorage::getDeviceDataPin(int index) {
+    if (allDevicesLoaded || deviceLoaded[index]) return devices[index].dataPin;
+    return deviceRecords[index].dataPin;
+}
+
+const std::vector<DeviceConfig>& PersistentStorage::getDevices() {
+    loadAllDevices();
+    return devices;
+}
+
+const std::vector<NetworkConfig>& PersistentStorage::getNetworks() {
+    loadNetworks();
+    return networks;
 }
 
 bool PersistentStorage::clearAll() {
-    if (SPIFFS.remove(CONFIG_FILE)) {
+    if (readOnly) {
+        Serial.println("Config is read-only, not clearing it");
+        return false;
+    }
+    resetCache();
+    dirty = false;
+    needsSnapshot = true;
+    journalSize = 0;
+    backend.remove(CONFIG_FILE);
+    backend.remove(CONFIG_JSON_BACKUP);
+    backend.remove(CONFIG_JOURNAL_FILE);
+    backend.remove(CONFIG_TMP_FILE);
+    backend.remove(CONFIG_BIN_FILE);
+    if (!backend.exists(CONFIG_BIN_FILE)) {
         Serial.println("All data cleared");
         return true;
     }
@@ -310,27 +1071,32 @@ bool PersistentStorage::clearAll() {
 }
 
 void PersistentStorage::getStorageInfo() {
-    size_t totalBytes = SPIFFS.totalBytes();
-    size_t usedBytes = SPIFFS.usedBytes();
-    Serial.println("\n--- SPIFFS Storage Info ---");
+    size_t totalBytes = backend.totalBytes();
+    size_t usedBytes = backend.usedBytes();
+    Serial.println("\n--- " + String(backend.name()) + " Storage Info ---");
     Serial.println("Total space: " + String(totalBytes) + " bytes");
     Serial.println("Used space: " + String(usedBytes) + " bytes");
     Serial.println("Free space: " + String(totalBytes - usedBytes) + " bytes");
-    Serial.println("Usage: " + String((usedBytes * 100) / totalBytes) + "%");
-    if (SPIFFS.exists(CONFIG_FILE)) {
-        File file = SPIFFS.open(CONFIG_FILE, "r");
-        Serial.println("Config file size: " + String(file.size()) + " bytes");
-        file.close();
+    if (totalBytes > 0) {
+        Serial.println("Usage: " + String((usedBytes * 100) / totalBytes) + "%");
     }
+    if (backend.exists(CONFIG_BIN_FILE)) {
+        Serial.println("Config file size: " + String(backend.size(CONFIG_BIN_FILE)) + " bytes");
+    }
+    Serial.println("Config journal: " + String(journalSize) + " bytes");
+    Serial.println("Config changes: " + String(stats.mutations) + ", flushes: " + String(stats.flushes) +
+                   ", bytes written: " + String(stats.bytesWritten) +
+                   ", flash time: " + String((uint32_t)(stats.flashUs / 1000)) + " ms");
 }
 
 bool PersistentStorage::formatSPIFFS() {
-    Serial.println("Formatting SPIFFS...");
-    if (SPIFFS.format()) {
-        Serial.println("SPIFFS formatted successfully");
+    Serial.println("Formatting " + String(backend.name()) + "...");
+    if (backend.format()) {
+        readOnly = false;
+        Serial.println(String(backend.name()) + " formatted successfully");
         return true;
     }
-    Serial.println("SPIFFS format failed");
+    Serial.println(String(backend.name()) + " format failed");
     return false;
 }
 
@@ -341,7 +1107,8 @@ bool PersistentStorage::interactiveSetup() {
     Serial.println("3. Clear all data (with confirmation)");
     Serial.println("4. Continue with current settings");
     Serial.println("5. Show current configuration");
-    Serial.print("Select option (1-5): ");
+    Serial.println("6. Run storage benchmark (10 to 1000 devices)");
+    Serial.print("Select option (1-6): ");
     
     while (!Serial.available()) {
         delay(100);
@@ -362,9 +1129,13 @@ bool PersistentStorage::interactiveSetup() {
             Serial.println("Continuing with current settings...");
             return true;
         case 5:
+            getStorageInfo();
             Serial.println("\nCurrent configuration:");
             Serial.println(getAllData());
             return interactiveSetup(); // Show menu again
+        case 6:
+            runStorageBenchmark();
+            return interactiveSetup();
         default:
             Serial.println("Invalid option. Please try again.");
             return interactiveSetup();
@@ -403,24 +1174,61 @@ bool PersistentStorage::editDeviceConfig() {
     numLeds = (numLedsStr.length() == 0) ? 30 : numLedsStr.toInt();
     if (numLeds <= 0) numLeds = 30;
     
+    int matrixWidth = 0;
+    bool serpentine = true;
+    if (deviceType == "matrix") {
+        Serial.print("Matrix width in LEDs [" + String(numLeds) + "]: ");
+        while (!Serial.available()) delay(100);
+        String widthStr = Serial.readStringUntil('\n');
+        widthStr.trim();
+        matrixWidth = widthStr.toInt();
+        if (matrixWidth <= 0 || matrixWidth > numLeds) matrixWidth = numLeds;
+        
+        Serial.print("Serpentine wiring (y/n) [y]: ");
+        while (!Serial.available()) delay(100);
+        String serpentineStr = Serial.readStringUntil('\n');
+        serpentineStr.trim();
+        serpentine = !serpentineStr.equalsIgnoreCase("n");
+    }
+    
+    int powerBudget;
+    Serial.print("Power budget in mA (0 = unlimited) [0]: ");
+    while (!Serial.available()) delay(100);
+    String powerBudgetStr = Serial.readStringUntil('\n');
+    powerBudgetStr.trim();
+    powerBudget = powerBudgetStr.toInt();
+    if (powerBudget < 0) powerBudget = 0;
+    
+    DeviceConfig device1;
+    device1.name = deviceName;
+    device1.type = deviceType;
+    device1.ledType = ledType;
+    device1.numLeds = numLeds;
+    device1.macAddress = getDeviceMacAddress();
+    device1.powerBudgetMa = powerBudget;
+    if (deviceType == "matrix") {
+        device1.matrixWidth = matrixWidth;
+        device1.serpentine = serpentine;
+    }
+    if (!deviceFitsRecord(device1)) {
+        return false;
+    }
+    
     // Clear existing config and create new one
-    clearAll();
-    JsonDocument doc;
-    JsonArray devices = doc["devices"].to<JsonArray>();
-    JsonObject device1 = devices.add<JsonObject>();
-    device1["device_name"] = deviceName;
-    device1["device_type"] = deviceType;
-    device1["led_type"] = ledType;
-    device1["num_of_leds"] = numLeds;
-    device1["mac_address"] = getDeviceMacAddress();
+    if (!clearAll()) {
+        return false;
+    }
+    setDevice(-1, device1);
     
     // Add default network
-    JsonArray networks = doc["networks"].to<JsonArray>();
-    JsonObject network1 = networks.add<JsonObject>();
-    network1["ssid"] = "HomeNetwork";
-    network1["password"] = "password123";
+    NetworkConfig network1;
+    network1.ssid = "HomeNetwork";
+    network1.password = "password123";
+    networks.push_back(network1);
     
-    if (saveData(doc)) {
+    needsSnapshot = true;
+    commit();
+    if (flush()) {
         Serial.println("Device configuration saved successfully!");
         Serial.println("New configuration:");
         Serial.println(getAllData());
@@ -448,20 +1256,17 @@ bool PersistentStorage::editNetworkConfig() {
     password.trim();
     if (password.length() == 0) password = "password123";
     
-    JsonDocument doc = loadData();
-    JsonArray networks = doc["networks"];
-    
     // Update first network or create new one
-    if (networks.size() > 0) {
-        networks[0]["ssid"] = ssid;
-        networks[0]["password"] = password;
-    } else {
-        JsonObject newNetwork = networks.add<JsonObject>();
-        newNetwork["ssid"] = ssid;
-        newNetwork["password"] = password;
-    }
+    loadNetworks();
+    NetworkConfig network;
+    network.ssid = ssid;
+    network.password = password;
+    String key = networks.size() > 0 ? networks[0].ssid : ssid;
+    setNetwork(networks.size() > 0 ? 0 : -1, network);
+    journalNetwork(key, network);
     
-    if (saveData(doc)) {
+    commit();
+    if (flush()) {
         Serial.println("Network configuration saved successfully!");
         return true;
     } else {
@@ -495,19 +1300,15 @@ bool PersistentStorage::clearDataWithConfirmation() {
 }
 
 String PersistentStorage::getFirstDeviceName() {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    if (devices.size() > 0) {
-        return devices[0]["device_name"] | "LEDStrip1";
+    if (devices.size() > 0 && deviceAt(0).name.length() > 0) {
+        return devices[0].name;
     }
     return "LEDStrip1"; // Default fallback
 }
 
 String PersistentStorage::getDeviceName() {
-    JsonDocument doc = loadData();
-    JsonArray devices = doc["devices"];
-    if (devices.size() > 0) {
-        return devices[0]["device_name"] | "HMZ-LED-Controller";
+    if (devices.size() > 0 && deviceAt(0).name.length() > 0) {
+        return devices[0].name;
     }
     return "HMZ-LED-Controller";
-}
\ No newline at end of file
+}
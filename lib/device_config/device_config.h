@@ -1,20 +1,149 @@
 #pragma once
 
 #include <Arduino.h>
-#include <SPIFFS.h>
 #include <ArduinoJson.h>
-#include <FS.h>
 #include <esp_system.h>
 #include <esp_mac.h>
+#include <vector>
+#include "config_format.h"
+#include "key_index.h"
+#include "storage_backend.h"
+
+// One entry of the "devices" array. The first device is this controller's own
+// strip; the rest are extra local strips (with a data pin) or BLE peers.
+struct DeviceConfig {
+    String name;
+    String type;
+    String ledType;
+    int numLeds = 30;
+    String macAddress;
+    int dataPin = -1;           // -1 when the entry has no data_pin
+    int powerBudgetMa = 0;
+    int matrixWidth = 0;
+    bool serpentine = true;
+    String extra;               // Any other keys, as a serialized JSON object
+};
+
+struct NetworkConfig {
+    String ssid;
+    String password;
+};
+
+// Changes are batched in RAM and flushed once they stop arriving
+#define FLUSH_DEBOUNCE_MS 1000
+#define FLUSH_MAX_DELAY_MS 5000     // Flush even if changes keep coming
+#define JOURNAL_COMPACT_BYTES 4096  // Fold the journal into a new snapshot past this size
+
+struct StorageStats {
+    uint32_t mutations = 0;         // Changes to the config
+    uint32_t flushes = 0;           // Config files written
+    uint32_t failedFlushes = 0;
+    uint32_t bytesWritten = 0;      // Written to flash
+    uint32_t bytesRead = 0;         // Read from flash
+    uint32_t journalAppends = 0;
+    uint32_t compactions = 0;       // Snapshot rewrites
+    uint64_t flashUs = 0;           // Time spent in backend calls
+};
 
 class PersistentStorage {
 private:
-    static const char* CONFIG_FILE;
-    JsonDocument loadData();
-    bool saveData(const JsonDocument& doc);
+    StorageBackend& backend;
+    static const char* CONFIG_BIN_FILE;
+    static const char* CONFIG_TMP_FILE;
+    static const char* CONFIG_JOURNAL_FILE;
+    static const char* CONFIG_FILE;         // Legacy JSON config, migrated at begin()
+    static const char* CONFIG_JSON_BACKUP;
+    
+    // Typed copy of /config.bin. begin() reads only the header and the record
+    // table; a device's strings are decoded the first time it is accessed and
+    // the networks the first time any of them is. Anything that edits or
+    // searches the lists loads them completely first.
+    std::vector<DeviceConfig> devices;
+    std::vector<NetworkConfig> networks;
+    std::vector<DeviceRecord> deviceRecords;
+    std::vector<NetworkRecord> networkRecords;
+    std::vector<bool> deviceLoaded;
+    bool allDevicesLoaded = true;
+    bool networksLoaded = true;
+    uint32_t stringsOffset = 0;
+    uint32_t stringsSize = 0;
+    uint16_t fileSchemaVersion = CONFIG_SCHEMA_VERSION;
+    uint32_t snapshotCrc = 0;               // headerCrc of the current /config.bin
+    bool readOnly = false;                  // /config.bin is from newer firmware; never rewritten
+    bool ready = false;                     // begin() succeeded; loop() only flushes then
+    
+    // Mutations mark the cache dirty and queue a journal record; loop() appends
+    // the queued records after FLUSH_DEBOUNCE_MS of quiet, and never while a
+    // transaction is open. Changes that replace the whole config, or a journal
+    // past JOURNAL_COMPACT_BYTES, rewrite the snapshot instead.
+    std::vector<uint8_t> pendingJournal;
+    size_t journalSize = 0;                 // Bytes in /config.log
+    bool needsSnapshot = false;
+    bool dirty = false;
+    
+    // Lookups by device_name, mac_address and ssid. Built on first lookup and
+    // updated in place by appends, removals and key changes.
+    KeyIndex deviceNameIndex;
+    KeyIndex deviceMacIndex;
+    KeyIndex networkSsidIndex;
+    bool deviceIndexValid = false;
+    bool networkIndexValid = false;
+    int transactionDepth = 0;
+    std::vector<uint8_t> transactionBase;   // pendingJournal when the outermost transaction began
+    bool transactionBaseDirty = false;
+    bool transactionUndoable = false;
+    unsigned long firstChangeMs = 0;
+    unsigned long lastChangeMs = 0;
+    StorageStats stats;
+    
+    void resetCache();
+    bool open();
+    bool openBinary();
+    bool writeBinary();
+    void replayJournal();
+    size_t applyJournalRecords(const uint8_t* data, size_t length, int& applied);
+    void applyJournalRecord(uint8_t op, JsonObjectConst payload);
+    void journal(uint8_t op, const JsonDocument& payload);
+    void journalDevice(const String& key, const DeviceConfig& device);
+    void journalNetwork(const String& key, const NetworkConfig& network);
+    void journalRemove(uint8_t op, const String& key);
+    bool appendJournal();
+    String readString(const StringRef& ref, uint32_t& crc);
+    DeviceConfig& deviceAt(size_t index);
+    void loadAllDevices();
+    void loadNetworks();
+    JsonDocument loadData(const char* path);
+    void loadJsonCache(const char* path);
+    bool commit();
+    JsonDocument toDocument();
+    int deviceIndexOf(const String& deviceName);
+    int deviceIndexOfMac(const String& macAddress);
+    int networkIndexOf(const String& ssid);
+    bool setDevice(int index, const DeviceConfig& device);
+    void setNetwork(int index, const NetworkConfig& network);
+    bool eraseDevice(const String& deviceName);
+    bool eraseNetwork(const String& ssid);
+    DeviceConfig* findDevice(const String& deviceName);
+    NetworkConfig* findNetwork(const String& ssid);
+    bool setDeviceKey(const String& deviceName, const String& key, JsonVariantConst value);
+    static DeviceConfig deviceFromJson(JsonObjectConst object);
+    static void deviceToJson(const DeviceConfig& device, JsonObject object);
 
 public:
+    PersistentStorage(StorageBackend& backend = defaultStorageBackend()) : backend(backend) {}
+    
     bool begin();
+    void loop();
+    bool flush();
+    bool compact();                 // Rewrite the snapshot and drop the journal now
+    void beginTransaction();
+    bool commitTransaction();
+    bool rollbackTransaction();     // Undoes everything since the outermost beginTransaction()
+    bool isDirty() const { return dirty; }
+    bool isReadOnly() const { return readOnly; }
+    bool isReady() const { return ready; }
+    const StorageStats& getStats() const { return stats; }
+    void reportStats(JsonObject out) const;
     bool initializeDefaultData();
     bool interactiveSetup();
     bool editDeviceConfig();
@@ -41,7 +170,11 @@ public:
     bool networkExists(const String& ssid);
     int getDeviceCount();
     int getNetworkCount();
+    const DeviceConfig& getDeviceConfig(int index);    // Decodes only this device
+    int getDeviceDataPin(int index);                   // Read from the record table
+    const std::vector<DeviceConfig>& getDevices();
+    const std::vector<NetworkConfig>& getNetworks();
     bool clearAll();
     void getStorageInfo();
-    bool formatSPIFFS();
+    bool formatSPIFFS();            // Formats whichever backend is in use
 };
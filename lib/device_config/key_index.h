@@ -0,0 +1,100 @@
+#pragma once
+
+#include <Arduino.h>
+#include <vector>
+
+// Open-addressed hash index from a string key to entry positions. Each slot
+// packs a 16-bit key hash with the entry index + 1 (0 = empty), so the table
+// costs 4 bytes per slot at <= 50% load. Removal uses backward-shift deletion,
+// so there are no tombstones and probe runs stay as short as after a rebuild.
+class KeyIndex {
+public:
+    void clear() {
+        slots.clear();
+        count = 0;
+    }
+    
+    void add(const String& key, size_t index) {
+        if ((count + 1) * 2 > slots.size()) rehash(slots.empty() ? 16 : slots.size() * 2);
+        insert(hashKey(key), index);
+        count++;
+    }
+    
+    // Drops entry `index`, added under `key`; a rename is remove() then add()
+    void remove(const String& key, size_t index) {
+        if (slots.empty()) return;
+        uint32_t entry = ((uint32_t)hashKey(key) << 16) | (uint32_t)(index + 1);
+        size_t mask = slots.size() - 1;
+        size_t slot = (entry >> 16) & mask;
+        while (slots[slot] != entry) {
+            if (slots[slot] == 0) return;
+            slot = (slot + 1) & mask;
+        }
+        // Pull later entries of the probe run back into the gap, unless their
+        // home slot lies between the gap and where they sit
+        size_t gap = slot;
+        for (size_t next = (gap + 1) & mask; slots[next] != 0; next = (next + 1) & mask) {
+            size_t home = (slots[next] >> 16) & mask;
+            if (((next - home) & mask) >= ((next - gap) & mask)) {
+                slots[gap] = slots[next];
+                gap = next;
+            }
+        }
+        slots[gap] = 0;
+        count--;
+    }
+    
+    // For an entry erased from the owner's array: drops it and moves every
+    // later position down one. One pass over the slots; no key is rehashed.
+    void erase(const String& key, size_t index) {
+        remove(key, index);
+        uint32_t last = index + 1;
+        for (uint32_t& slot : slots) {
+            slot -= (slot & 0xFFFF) > last;     // Empty slots hold 0, never above
+        }
+    }
+    
+    // Lowest index whose key matches, or -1; keyAt(i) returns entry i's key
+    template <typename KeyAt>
+    int find(const String& key, KeyAt keyAt) const {
+        if (slots.empty()) return -1;
+        uint16_t hash = hashKey(key);
+        size_t mask = slots.size() - 1;
+        int found = -1;
+        for (size_t slot = hash & mask; slots[slot] != 0; slot = (slot + 1) & mask) {
+            if ((slots[slot] >> 16) != hash) continue;
+            int index = (int)(slots[slot] & 0xFFFF) - 1;
+            if ((found < 0 || index < found) && keyAt(index) == key) found = index;
+        }
+        return found;
+    }
+    
+private:
+    std::vector<uint32_t> slots;    // hash << 16 | (index + 1)
+    size_t count = 0;
+    
+    // FNV-1a folded to 16 bits; also the home slot, so tables stay <= 64K slots
+    static uint16_t hashKey(const String& key) {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < key.length(); i++) {
+            hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+        }
+        return (hash >> 16) ^ (hash & 0xFFFF);
+    }
+    
+    void insert(uint16_t hash, size_t index) {
+        size_t mask = slots.size() - 1;
+        size_t slot = hash & mask;
+        while (slots[slot] != 0) slot = (slot + 1) & mask;
+        slots[slot] = ((uint32_t)hash << 16) | (uint32_t)(index + 1);
+    }
+    
+    void rehash(size_t capacity) {
+        std::vector<uint32_t> old;
+        old.swap(slots);
+        slots.assign(capacity, 0);
+        for (uint32_t entry : old) {
+            if (entry != 0) insert(entry >> 16, (entry & 0xFFFF) - 1);
+        }
+    }
+};
@@ -0,0 +1,264 @@
+#include "storage_backend.h"
+#include <SPIFFS.h>
+#include <LittleFS.h>
+#include <nvs.h>
+
+// ---- Filesystems ----
+
+bool FsBackend::exists(const char* path) {
+    return fs.exists(fullPath(path));
+}
+
+size_t FsBackend::size(const char* path) {
+    if (readPath == path && readFile) return readFile.size();
+    File file = fs.open(fullPath(path), "r");
+    if (!file) return 0;
+    size_t length = file.size();
+    file.close();
+    return length;
+}
+
+size_t FsBackend::read(const char* path, size_t offset, uint8_t* buffer, size_t length) {
+    if (readPath != path || !readFile) {
+        closeRead();
+        readFile = fs.open(fullPath(path), "r");
+        if (!readFile) return 0;
+        readPath = path;
+    }
+    if (!readFile.seek(offset)) return 0;
+    return readFile.read(buffer, length);
+}
+
+bool FsBackend::writeMode(const char* path, const char* mode, const uint8_t* data, size_t length) {
+    closeRead();
+    File file = fs.open(fullPath(path), mode, true);
+    if (!file) return false;
+    size_t written = length > 0 ? file.write(data, length) : 0;
+    file.close();
+    return written == length;
+}
+
+bool FsBackend::write(const char* path, const uint8_t* data, size_t length) {
+    return writeMode(path, "w", data, length);
+}
+
+bool FsBackend::append(const char* path, const uint8_t* data, size_t length) {
+    return writeMode(path, "a", data, length);
+}
+
+// LittleFS renames over an existing file atomically; SPIFFS refuses, so the
+// target is removed first (PersistentStorage recovers from a cut in between)
+bool FsBackend::rename(const char* from, const char* to) {
+    closeRead();
+    if (fs.rename(fullPath(from), fullPath(to))) return true;
+    if (!fs.exists(fullPath(to))) return false;
+    fs.remove(fullPath(to));
+    return fs.rename(fullPath(from), fullPath(to));
+}
+
+bool FsBackend::remove(const char* path) {
+    closeRead();
+    return fs.remove(fullPath(path));
+}
+
+SpiffsBackend::SpiffsBackend(const char* root) : FsBackend(SPIFFS, root) {}
+
+bool SpiffsBackend::begin() {
+    if (!SPIFFS.begin(true)) {
+        Serial.println("SPIFFS Mount Failed");
+        return false;
+    }
+    Serial.println("SPIFFS mounted successfully");
+    return true;
+}
+
+size_t SpiffsBackend::totalBytes() { return SPIFFS.totalBytes(); }
+size_t SpiffsBackend::usedBytes() { return SPIFFS.usedBytes(); }
+bool SpiffsBackend::format() { closeRead(); return SPIFFS.format(); }
+
+LittleFsBackend::LittleFsBackend(const char* root) : FsBackend(LittleFS, root) {}
+
+bool LittleFsBackend::begin() {
+    if (!LittleFS.begin(true)) {
+        Serial.println("LittleFS Mount Failed");
+        return false;
+    }
+    Serial.println("LittleFS mounted successfully");
+    if (root.length() > 0 && !LittleFS.exists(root)) {
+        LittleFS.mkdir(root.c_str());
+    }
+    return true;
+}
+
+size_t LittleFsBackend::totalBytes() { return LittleFS.totalBytes(); }
+size_t LittleFsBackend::usedBytes() { return LittleFS.usedBytes(); }
+bool LittleFsBackend::format() { closeRead(); return LittleFS.format(); }
+
+// ---- NVS ----
+
+bool NvsBackend::begin() {
+    // Every PersistentStorage over this backend calls begin()
+    if (opened) return true;
+    if (!prefs.begin(nvsNamespace, false)) {
+        Serial.println("NVS namespace open failed: " + String(nvsNamespace));
+        return false;
+    }
+    opened = true;
+    return true;
+}
+
+bool NvsBackend::load(const char* path) {
+    if (cacheKey == path) return true;
+    size_t length = prefs.getBytesLength(key(path));
+    if (length == 0) return false;
+    cache.resize(length);
+    if (prefs.getBytes(key(path), cache.data(), length) != length) {
+        cacheKey = "";
+        return false;
+    }
+    cacheKey = path;
+    return true;
+}
+
+bool NvsBackend::exists(const char* path) {
+    return prefs.isKey(key(path));
+}
+
+size_t NvsBackend::size(const char* path) {
+    return prefs.getBytesLength(key(path));
+}
+
+size_t NvsBackend::read(const char* path, size_t offset, uint8_t* buffer, size_t length) {
+    if (!load(path) || offset >= cache.size()) return 0;
+    length = min(length, cache.size() - offset);
+    memcpy(buffer, cache.data() + offset, length);
+    return length;
+}
+
+bool NvsBackend::write(const char* path, const uint8_t* data, size_t length) {
+    cacheKey = "";
+    if (length == 0) {
+        prefs.remove(key(path));
+        return true;
+    }
+    return prefs.putBytes(key(path), data, length) == length;
+}
+
+bool NvsBackend::append(const char* path, const uint8_t* data, size_t length) {
+    std::vector<uint8_t> blob;
+    if (load(path)) blob = cache;
+    blob.insert(blob.end(), data, data + length);
+    return write(path, blob.data(), blob.size());
+}
+
+bool NvsBackend::rename(const char* from, const char* to) {
+    if (!load(from)) return false;
+    std::vector<uint8_t> blob = cache;
+    if (!write(to, blob.data(), blob.size())) return false;
+    return remove(from);
+}
+
+bool NvsBackend::remove(const char* path) {
+    cacheKey = "";
+    return prefs.remove(key(path));
+}
+
+// NVS stores 32-byte entries; these are partition-wide figures
+size_t NvsBackend::totalBytes() {
+    nvs_stats_t stats;
+    if (nvs_get_stats(NULL, &stats) != ESP_OK) return 0;
+    return stats.total_entries * 32;
+}
+
+size_t NvsBackend::usedBytes() {
+    nvs_stats_t stats;
+    if (nvs_get_stats(NULL, &stats) != ESP_OK) return 0;
+    return stats.used_entries * 32;
+}
+
+bool NvsBackend::format() {
+    cacheKey = "";
+    return prefs.clear();
+}
+
+// ---- RAM ----
+
+MemoryBackend::MemoryFile* MemoryBackend::find(const char* path) {
+    for (MemoryFile& file : files) {
+        if (file.path == path) return &file;
+    }
+    return nullptr;
+}
+
+size_t MemoryBackend::size(const char* path) {
+    MemoryFile* file = find(path);
+    return file ? file->data.size() : 0;
+}
+
+size_t MemoryBackend::read(const char* path, size_t offset, uint8_t* buffer, size_t length) {
+    MemoryFile* file = find(path);
+    if (!file || offset >= file->data.size()) return 0;
+    length = min(length, file->data.size() - offset);
+    memcpy(buffer, file->data.data() + offset, length);
+    return length;
+}
+
+bool MemoryBackend::write(const char* path, const uint8_t* data, size_t length) {
+    MemoryFile* file = find(path);
+    if (!file) {
+        files.push_back(MemoryFile{ path, {} });
+        file = &files.back();
+    }
+    file->data.assign(data, data + length);
+    return true;
+}
+
+bool MemoryBackend::append(const char* path, const uint8_t* data, size_t length) {
+    MemoryFile* file = find(path);
+    if (!file) return write(path, data, length);
+    file->data.insert(file->data.end(), data, data + length);
+    return true;
+}
+
+bool MemoryBackend::rename(const char* from, const char* to) {
+    if (!find(from)) return false;
+    if (strcmp(from, to) == 0) return true;
+    remove(to);
+    find(from)->path = to;
+    return true;
+}
+
+bool MemoryBackend::remove(const char* path) {
+    for (size_t i = 0; i < files.size(); i++) {
+        if (files[i].path == path) {
+            files.erase(files.begin() + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t MemoryBackend::totalBytes() {
+    return ESP.getHeapSize();
+}
+
+size_t MemoryBackend::usedBytes() {
+    size_t used = 0;
+    for (const MemoryFile& file : files) used += file.data.size();
+    return used;
+}
+
+// ---- Selection ----
+
+StorageBackend& defaultStorageBackend() {
+#if defined(STORAGE_BACKEND_LITTLEFS)
+    static LittleFsBackend backend;
+#elif defined(STORAGE_BACKEND_NVS)
+    static NvsBackend backend("hmzconfig");
+#elif defined(STORAGE_BACKEND_MEMORY)
+    static MemoryBackend backend;
+#else
+    static SpiffsBackend backend;
+#endif
+    return backend;
+}
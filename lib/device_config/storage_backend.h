@@ -0,0 +1,135 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <Preferences.h>
+#include <vector>
+
+// Where PersistentStorage keeps its files. Paths are flat names like
+// "/config.bin"; each backend maps them into its own space (a directory on a
+// filesystem, keys in an NVS namespace), so several stores can share a device.
+//
+// Build flags pick the backend used by the global config store:
+//   STORAGE_BACKEND_LITTLEFS   LittleFS on the "spiffs" partition
+//   STORAGE_BACKEND_NVS        Blobs in the NVS partition (Preferences)
+//   STORAGE_BACKEND_MEMORY     RAM only, lost on reset (testing)
+//   (none)                     SPIFFS
+class StorageBackend {
+public:
+    virtual ~StorageBackend() {}
+    virtual const char* name() const = 0;
+    virtual bool begin() = 0;
+    virtual bool exists(const char* path) = 0;
+    virtual size_t size(const char* path) = 0;      // 0 when missing
+    virtual size_t read(const char* path, size_t offset, uint8_t* buffer, size_t length) = 0;
+    virtual bool write(const char* path, const uint8_t* data, size_t length) = 0;     // Replaces the file
+    virtual bool append(const char* path, const uint8_t* data, size_t length) = 0;
+    virtual bool rename(const char* from, const char* to) = 0;                       // Replaces `to`
+    virtual bool remove(const char* path) = 0;
+    virtual size_t totalBytes() = 0;
+    virtual size_t usedBytes() = 0;
+    virtual bool format() = 0;
+};
+
+// Files on an Arduino filesystem. The last file read stays open, so lazy
+// reads of one file cost a seek rather than an open each.
+class FsBackend : public StorageBackend {
+public:
+    FsBackend(fs::FS& fs, const char* root) : fs(fs), root(root) {}
+    bool exists(const char* path) override;
+    size_t size(const char* path) override;
+    size_t read(const char* path, size_t offset, uint8_t* buffer, size_t length) override;
+    bool write(const char* path, const uint8_t* data, size_t length) override;
+    bool append(const char* path, const uint8_t* data, size_t length) override;
+    bool rename(const char* from, const char* to) override;
+    bool remove(const char* path) override;
+
+protected:
+    fs::FS& fs;
+    String root;
+    File readFile;
+    String readPath;
+    
+    String fullPath(const char* path) const { return root + path; }
+    void closeRead() { if (readFile) readFile.close(); readPath = ""; }
+    bool writeMode(const char* path, const char* mode, const uint8_t* data, size_t length);
+};
+
+class SpiffsBackend : public FsBackend {
+public:
+    SpiffsBackend(const char* root = "");
+    const char* name() const override { return "SPIFFS"; }
+    bool begin() override;
+    size_t totalBytes() override;
+    size_t usedBytes() override;
+    bool format() override;
+};
+
+class LittleFsBackend : public FsBackend {
+public:
+    LittleFsBackend(const char* root = "");
+    const char* name() const override { return "LittleFS"; }
+    bool begin() override;
+    size_t totalBytes() override;
+    size_t usedBytes() override;
+    bool format() override;
+};
+
+// One NVS blob per path, keyed by the path without its leading '/' (NVS keys
+// are at most 15 characters). NVS has no partial reads, so the last blob read
+// is cached; NVS is itself log-structured, so rewriting a blob is wear-levelled.
+class NvsBackend : public StorageBackend {
+public:
+    NvsBackend(const char* nvsNamespace) : nvsNamespace(nvsNamespace), opened(false) {}
+    const char* name() const override { return "NVS"; }
+    bool begin() override;
+    bool exists(const char* path) override;
+    size_t size(const char* path) override;
+    size_t read(const char* path, size_t offset, uint8_t* buffer, size_t length) override;
+    bool write(const char* path, const uint8_t* data, size_t length) override;
+    bool append(const char* path, const uint8_t* data, size_t length) override;
+    bool rename(const char* from, const char* to) override;
+    bool remove(const char* path) override;
+    size_t totalBytes() override;
+    size_t usedBytes() override;
+    bool format() override;
+
+private:
+    const char* nvsNamespace;
+    bool opened;            // Preferences::begin() fails if the namespace is already open
+    Preferences prefs;
+    std::vector<uint8_t> cache;
+    String cacheKey;
+    
+    static const char* key(const char* path) { return path[0] == '/' ? path + 1 : path; }
+    bool load(const char* path);
+};
+
+// Files held in RAM; nothing survives a reset
+class MemoryBackend : public StorageBackend {
+public:
+    const char* name() const override { return "Memory"; }
+    bool begin() override { return true; }
+    bool exists(const char* path) override { return find(path) != nullptr; }
+    size_t size(const char* path) override;
+    size_t read(const char* path, size_t offset, uint8_t* buffer, size_t length) override;
+    bool write(const char* path, const uint8_t* data, size_t length) override;
+    bool append(const char* path, const uint8_t* data, size_t length) override;
+    bool rename(const char* from, const char* to) override;
+    bool remove(const char* path) override;
+    size_t totalBytes() override;
+    size_t usedBytes() override;
+    bool format() override { files.clear(); return true; }
+
+private:
+    struct MemoryFile {
+        String path;
+        std::vector<uint8_t> data;
+    };
+    std::vector<MemoryFile> files;
+    
+    MemoryFile* find(const char* path);
+};
+
+// The backend chosen by the STORAGE_BACKEND_* build flags
+StorageBackend& defaultStorageBackend();
@@ -0,0 +1,145 @@
+#include "storage_benchmark.h"
+#include "device_config.h"
+
+#define BENCHMARK_UPDATES 10
+#define BENCHMARK_LOOKUPS 100
+#define BENCHMARK_REMOVALS 10
+#define BENCHMARK_HEAP_PER_DEVICE 600   // Decoded record, snapshot and journal share, with slack
+
+static const int SWEEP_SIZES[] = { 10, 100, 250, 500, 1000 };
+
+struct BenchmarkResult {
+    bool ok = false;
+    unsigned long bootUs = 0;       // begin() + first device name, lazy decode
+    unsigned long loadAllUs = 0;    // Decoding every record after boot
+    unsigned long updateUs = 0;     // One property change flushed as a journal append
+    unsigned long rewriteUs = 0;    // Full snapshot rewrite
+    unsigned long lookupNs = 0;     // deviceExists() by name, through the hash index
+    unsigned long removeUs = 0;     // removeDevice() plus the next lookup, indexes updated in place
+};
+
+static BenchmarkResult benchmarkBackend(StorageBackend& backend, int deviceCount) {
+    BenchmarkResult result;
+    {
+        PersistentStorage store(backend);
+        if (!store.begin() || !store.clearAll()) return result;
+        store.beginTransaction();
+        for (int i = 0; i < deviceCount; i++) {
+            char mac[18];
+            snprintf(mac, sizeof(mac), "BE:4E:43:48:%02X:%02X", (i >> 8) & 0xFF, i & 0xFF);
+            store.addDevice("BenchDevice" + String(i), "strip", "WS2812B", 30, mac);
+        }
+        store.commitTransaction();
+        
+        Serial.flush();
+        unsigned long start = micros();
+        store.compact();
+        result.rewriteUs = micros() - start;
+        
+        // Updates log a line each, so time them by the store's own backend clock
+        uint64_t flashStart = store.getStats().flashUs;
+        for (int i = 0; i < BENCHMARK_UPDATES; i++) {
+            store.updateDeviceProperty("BenchDevice0", "num_of_leds", 31 + i);
+            store.flush();
+        }
+        result.updateUs = (store.getStats().flashUs - flashStart) / BENCHMARK_UPDATES;
+        store.compact();
+    }
+    {
+        PersistentStorage store(backend);
+        Serial.flush();
+        unsigned long start = micros();
+        result.ok = store.begin() && store.getDeviceName() == "BenchDevice0";
+        result.bootUs = micros() - start;
+        
+        // Names are built first so the loop times the lookup, not String allocation
+        std::vector<String> names;
+        for (int i = 0; i < BENCHMARK_LOOKUPS; i++) {
+            names.push_back("BenchDevice" + String((i * 7919) % deviceCount));
+        }
+        int found = 0;
+        start = micros();
+        for (const String& name : names) {
+            found += store.deviceExists(name);
+        }
+        result.lookupNs = (micros() - start) * 1000UL / BENCHMARK_LOOKUPS;
+        result.ok = result.ok && found == BENCHMARK_LOOKUPS;
+        
+        start = micros();
+        result.ok = result.ok && (int)store.getDevices().size() == deviceCount;
+        result.loadAllUs = micros() - start;
+        
+        // From the front, so every later position shifts; each removal logs a
+        // short line, flushed out before the next one is timed
+        int removals = min(BENCHMARK_REMOVALS, deviceCount - 1);
+        unsigned long removeTotal = 0;
+        for (int i = 1; i <= removals; i++) {
+            Serial.flush();
+            start = micros();
+            bool removed = store.removeDevice("BenchDevice" + String(i));
+            found = store.deviceExists("BenchDevice0");
+            removeTotal += micros() - start;
+            result.ok = result.ok && removed && found;
+        }
+        result.removeUs = removals > 0 ? removeTotal / removals : 0;
+        store.clearAll();
+    }
+    return result;
+}
+
+static String padLeft(const String& text, unsigned int width) {
+    String padded;
+    while (padded.length() + text.length() < width) padded += ' ';
+    return padded + text;
+}
+
+static void benchmarkSize(StorageBackend** backends, int backendCount, int deviceCount) {
+    Serial.println("\n--- " + String(deviceCount) + " devices ---");
+    BenchmarkResult results[3];
+    for (int i = 0; i < backendCount; i++) {
+        if (ESP.getFreeHeap() < (uint32_t)deviceCount * BENCHMARK_HEAP_PER_DEVICE) {
+            Serial.println("Skipping " + String(backends[i]->name()) + ": not enough heap");
+            continue;
+        }
+        Serial.println("Running on " + String(backends[i]->name()) + "...");
+        results[i] = benchmarkBackend(*backends[i], deviceCount);
+    }
+    
+    Serial.println("\nTimes in microseconds, lookup in nanoseconds");
+    Serial.println("Backend        boot   load all     update    rewrite     lookup     remove");
+    for (int i = 0; i < backendCount; i++) {
+        String name = backends[i]->name();
+        while (name.length() < 9) name += ' ';
+        if (!results[i].ok) {
+            Serial.println(name + "   failed");
+            continue;
+        }
+        Serial.println(name + padLeft(String(results[i].bootUs), 9) +
+                       padLeft(String(results[i].loadAllUs), 11) +
+                       padLeft(String(results[i].updateUs), 11) +
+                       padLeft(String(results[i].rewriteUs), 11) +
+                       padLeft(String(results[i].lookupNs), 11) +
+                       padLeft(String(results[i].removeUs), 11));
+    }
+}
+
+void runStorageBenchmark(int deviceCount) {
+    Serial.println("\n=== Storage Benchmark ===");
+    
+#if defined(STORAGE_BACKEND_LITTLEFS)
+    LittleFsBackend fileBackend("/bench");
+#else
+    SpiffsBackend fileBackend("/bench");
+#endif
+    NvsBackend nvsBackend("hmzbench");
+    MemoryBackend memoryBackend;
+    StorageBackend* backends[] = { &fileBackend, &nvsBackend, &memoryBackend };
+    
+    if (deviceCount > 0) {
+        benchmarkSize(backends, 3, deviceCount);
+        return;
+    }
+    for (int size : SWEEP_SIZES) {
+        benchmarkSize(backends, 3, size);
+    }
+}
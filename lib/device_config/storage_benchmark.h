@@ -0,0 +1,11 @@
+#pragma once
+
+// Times the config store on every backend this build can reach: the mounted
+// filesystem (SPIFFS, or LittleFS when built with STORAGE_BACKEND_LITTLEFS;
+// both use the same partition, so compare them by flashing each build), NVS
+// and RAM. Benchmark files live apart from the real config ("/bench" and the
+// "hmzbench" NVS namespace) and are deleted afterwards.
+//
+// With no count it sweeps 10 to 1,000 devices to show how boot, lookups and
+// writes scale; the default NVS partition only holds the smaller sizes.
+void runStorageBenchmark(int deviceCount = 0);
@@ -0,0 +1,106 @@
+#include "frame_allocator.h"
+
+FrameAllocator::FrameAllocator() : internalArena{nullptr, 0, 0, 0},
+    psramArena{nullptr, 0, 0, 0}, allocationCount(0) {}
+
+FrameAllocator::~FrameAllocator() {
+    if (internalArena.base) {
+        heap_caps_free(internalArena.base);
+    }
+    if (psramArena.base) {
+        heap_caps_free(psramArena.base);
+    }
+}
+
+bool FrameAllocator::carve(Arena& arena, size_t size, uint32_t caps) {
+    arena.base = static_cast<uint8_t*>(heap_caps_malloc(size, caps));
+    arena.size = arena.base ? size : 0;
+    arena.used = 0;
+    arena.highWater = 0;
+    return arena.base != nullptr;
+}
+
+bool FrameAllocator::begin(size_t internalBytes, size_t psramBytes) {
+    if (isReady()) return true;
+    
+    // PSRAM first: whether it is there decides how much SRAM the defaults need
+    if (psramBytes > 0 && psramFound() && !psramArena.base) {
+        if (!carve(psramArena, psramBytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)) {
+            Serial.println("Frame pool: no PSRAM arena, large buffers stay internal");
+        }
+    }
+    if (internalBytes == FRAME_POOL_AUTO_SIZE) {
+        internalBytes = psramArena.base ? FRAME_POOL_INTERNAL_BYTES_PSRAM : FRAME_POOL_INTERNAL_BYTES;
+    }
+    if (!carve(internalArena, internalBytes, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)) {
+        Serial.println("Frame pool: failed to reserve " + String(internalBytes) + " bytes of internal SRAM");
+        return false;
+    }
+    
+    Serial.println("Frame pool: " + String(internalArena.size) + " bytes internal, " +
+                   String(psramArena.size) + " bytes PSRAM");
+    return true;
+}
+
+void* FrameAllocator::take(Arena& arena, size_t size) {
+    size_t aligned = (size + 3) & ~(size_t)3;
+    if (!arena.base || arena.size - arena.used < aligned) return nullptr;
+    void* ptr = arena.base + arena.used;
+    arena.used += aligned;
+    if (arena.used > arena.highWater) arena.highWater = arena.used;
+    return ptr;
+}
+
+void* FrameAllocator::allocate(const char* tag, size_t size, BufferPlacement placement) {
+    if (!isReady() && !begin()) return nullptr;
+    if (allocationCount == MAX_FRAME_ALLOCATIONS) {
+        Serial.println("Frame pool: too many buffers, cannot allocate " + String(tag));
+        return nullptr;
+    }
+    
+    bool wantPsram = placement == BufferPlacement::PSRAM ||
+                     (placement == BufferPlacement::AUTO && size >= FRAME_POOL_PSRAM_MIN_BYTES);
+    void* ptr = nullptr;
+    bool inPsram = false;
+    if (wantPsram) {
+        ptr = take(psramArena, size);
+        inPsram = ptr != nullptr;
+    }
+    if (!ptr) {
+        ptr = take(internalArena, size);
+    }
+    // An AUTO buffer small enough for SRAM may still fit in PSRAM when SRAM is full
+    if (!ptr && placement == BufferPlacement::AUTO) {
+        ptr = take(psramArena, size);
+        inPsram = ptr != nullptr;
+    }
+    if (!ptr) {
+        Serial.println("Frame pool exhausted allocating " + String(tag) + " (" + String(size) + " bytes)");
+        return nullptr;
+    }
+    
+    allocations[allocationCount++] = { tag, size, inPsram };
+    return ptr;
+}
+
+void FrameAllocator::reset() {
+    internalArena.used = 0;
+    psramArena.used = 0;
+    allocationCount = 0;
+}
+
+void FrameAllocator::writeReport(JsonObject report) const {
+    report["internal_size"] = internalArena.size;
+    report["internal_used"] = internalArena.used;
+    report["internal_high_water"] = internalArena.highWater;
+    report["psram_size"] = psramArena.size;
+    report["psram_used"] = psramArena.used;
+    report["psram_high_water"] = psramArena.highWater;
+    JsonArray buffers = report["buffers"].to<JsonArray>();
+    for (int i = 0; i < allocationCount; i++) {
+        JsonObject buffer = buffers.add<JsonObject>();
+        buffer["tag"] = allocations[i].tag;
+        buffer["bytes"] = allocations[i].size;
+        buffer["region"] = allocations[i].psram ? "psram" : "internal";
+    }
+}
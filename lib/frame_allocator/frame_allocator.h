@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_heap_caps.h>
+
+// Largest layout the arenas are sized for
+#define MAX_LED_STRIPS 8
+#define MAX_LEDS_PER_STRIP 300
+#define MAX_FRAME_LEDS (MAX_LED_STRIPS * MAX_LEDS_PER_STRIP)
+
+// Bytes per pixel. The render, front and back buffers and the hue/radius
+// maps always stay internal; the stream, layer and transition buffers are
+// AUTO and move to PSRAM when there is some.
+#define FRAME_POOL_HOT_BYTES_PER_LED (3 * 3 + 2)
+#define FRAME_POOL_COLD_BYTES_PER_LED (5 * 3)
+// Matrix xy tables: 2 bytes per cell, and a partly filled last row adds up
+// to one more row per strip
+#define FRAME_POOL_TABLE_BYTES (2 * (MAX_FRAME_LEDS + MAX_LED_STRIPS * MAX_LEDS_PER_STRIP))
+#define FRAME_POOL_SMALL_BYTES 1024     // Stream palette and alignment padding
+
+// Arenas carved out once at boot. The internal arena's size depends on
+// whether a PSRAM arena could be reserved next to it.
+#define FRAME_POOL_INTERNAL_BYTES (MAX_FRAME_LEDS * (FRAME_POOL_HOT_BYTES_PER_LED + FRAME_POOL_COLD_BYTES_PER_LED) + \
+                                   FRAME_POOL_TABLE_BYTES + FRAME_POOL_SMALL_BYTES)
+#define FRAME_POOL_INTERNAL_BYTES_PSRAM (MAX_FRAME_LEDS * FRAME_POOL_HOT_BYTES_PER_LED + \
+                                         FRAME_POOL_TABLE_BYTES + FRAME_POOL_SMALL_BYTES)
+#define FRAME_POOL_AUTO_SIZE 0
+#define FRAME_POOL_PSRAM_BYTES (512 * 1024)
+// AUTO buffers at least this big go to PSRAM when the board has it
+#define FRAME_POOL_PSRAM_MIN_BYTES 2048
+
+// Eleven fixed buffers per configuration plus one xy table per matrix strip
+#define FRAME_POOL_FIXED_BUFFERS 11
+#define MAX_FRAME_ALLOCATIONS (FRAME_POOL_FIXED_BUFFERS + MAX_LED_STRIPS)
+
+enum class BufferPlacement {
+    AUTO,       // PSRAM when large and available, otherwise internal
+    INTERNAL,   // Hot or ISR/DMA-read buffers that must stay in internal SRAM
+    PSRAM       // Prefer PSRAM even when small
+};
+
+// Bump allocator over fixed internal-SRAM and PSRAM arenas. Buffers are
+// never freed one by one: reset() drops them all before a re-configuration,
+// so repeated re-inits reuse the same memory and never fragment the heap.
+class FrameAllocator {
+private:
+    struct Arena {
+        uint8_t* base;
+        size_t size;
+        size_t used;
+        size_t highWater;
+    };
+    
+    struct Allocation {
+        const char* tag;
+        size_t size;
+        bool psram;
+    };
+    
+    Arena internalArena;
+    Arena psramArena;
+    Allocation allocations[MAX_FRAME_ALLOCATIONS];
+    int allocationCount;
+    
+    static bool carve(Arena& arena, size_t size, uint32_t caps);
+    static void* take(Arena& arena, size_t size);
+
+public:
+    FrameAllocator();
+    ~FrameAllocator();
+    
+    // FRAME_POOL_AUTO_SIZE reserves enough SRAM for MAX_FRAME_LEDS
+    bool begin(size_t internalBytes = FRAME_POOL_AUTO_SIZE,
+               size_t psramBytes = FRAME_POOL_PSRAM_BYTES);
+    bool isReady() const { return internalArena.base != nullptr; }
+    
+    void* allocate(const char* tag, size_t size, BufferPlacement placement = BufferPlacement::AUTO);
+    
+    template<typename T>
+    T* allocateArray(const char* tag, size_t count, BufferPlacement placement = BufferPlacement::AUTO) {
+        return static_cast<T*>(allocate(tag, count * sizeof(T), placement));
+    }
+    
+    void reset();
+    void writeReport(JsonObject report) const;
+};
@@ -0,0 +1,177 @@
+#include "frame_codec.h"
+
+#define OP_LITERAL 0x00
+#define OP_REPEAT 0x40
+#define OP_SKIP 0x80
+#define OP_LONG_SKIP 0xC0
+#define OP_TAG_MASK 0xC0
+#define OP_COUNT_MASK 0x3F
+
+static inline void applyPixel(CRGB& dst, const uint8_t* item, bool xorInto) {
+    if (xorInto) {
+        dst.r ^= item[0];
+        dst.g ^= item[1];
+        dst.b ^= item[2];
+    } else {
+        dst = CRGB(item[0], item[1], item[2]);
+    }
+}
+
+bool decodeFrame(FrameCodecMode mode, const uint8_t* data, size_t length,
+                 CRGB* dst, int count, const CRGB* palette) {
+    bool indexed = mode == FrameCodecMode::INDEXED_RLE;
+    bool xorInto = mode == FrameCodecMode::DELTA_RLE;
+    size_t itemSize = indexed ? 1 : 3;
+    if (indexed && !palette) return false;
+    
+    const uint8_t* end = data + length;
+    int pos = 0;
+    while (data < end) {
+        uint8_t op = *data++;
+        int run = (op & OP_COUNT_MASK) + 1;
+        uint8_t tag = op & OP_TAG_MASK;
+        if (tag == OP_LONG_SKIP) run *= FRAME_CODEC_MAX_RUN;
+        if (run > count - pos) return false;
+        
+        switch (tag) {
+            case OP_LITERAL:
+                if ((size_t)(end - data) < run * itemSize) return false;
+                if (indexed) {
+                    for (int i = 0; i < run; i++) dst[pos + i] = palette[data[i]];
+                } else if (!xorInto) {
+                    // CRGB is packed r, g, b like the wire format
+                    memcpy(dst + pos, data, run * sizeof(CRGB));
+                } else {
+                    for (int i = 0; i < run; i++) applyPixel(dst[pos + i], data + i * 3, true);
+                }
+                data += run * itemSize;
+                break;
+            case OP_REPEAT: {
+                if ((size_t)(end - data) < itemSize) return false;
+                if (indexed) {
+                    fill_solid(dst + pos, run, palette[*data]);
+                } else if (!xorInto) {
+                    fill_solid(dst + pos, run, CRGB(data[0], data[1], data[2]));
+                } else {
+                    for (int i = 0; i < run; i++) applyPixel(dst[pos + i], data, true);
+                }
+                data += itemSize;
+                break;
+            }
+            default:
+                // Skips leave the destination as it is
+                break;
+        }
+        pos += run;
+    }
+    return true;
+}
+
+// Shared run-length encoder over fixed-size items. changed() lets the delta
+// encoder turn unchanged (all-zero XOR) spans into skips.
+class RunEncoder {
+private:
+    uint8_t* out;
+    size_t capacity;
+    size_t used;
+    bool overflow;
+
+public:
+    RunEncoder(uint8_t* out, size_t capacity) : out(out), capacity(capacity), used(0), overflow(false) {}
+    
+    void emit(uint8_t op, const uint8_t* items, size_t bytes) {
+        if (overflow || used + 1 + bytes > capacity) {
+            overflow = true;
+            return;
+        }
+        out[used++] = op;
+        if (bytes > 0) {
+            memcpy(out + used, items, bytes);
+            used += bytes;
+        }
+    }
+    
+    void skip(int run) {
+        while (run >= FRAME_CODEC_MAX_RUN) {
+            int blocks = run / FRAME_CODEC_MAX_RUN;
+            if (blocks > FRAME_CODEC_MAX_RUN) blocks = FRAME_CODEC_MAX_RUN;
+            emit(OP_LONG_SKIP | (blocks - 1), nullptr, 0);
+            run -= blocks * FRAME_CODEC_MAX_RUN;
+        }
+        if (run > 0) emit(OP_SKIP | (run - 1), nullptr, 0);
+    }
+    
+    size_t finish() const { return overflow ? 0 : used; }
+};
+
+template<size_t ITEM_SIZE, typename ItemAt, typename IsSkip>
+static size_t encodeRuns(int count, ItemAt itemAt, IsSkip isSkip, uint8_t* out, size_t capacity) {
+    RunEncoder encoder(out, capacity);
+    uint8_t literal[FRAME_CODEC_MAX_RUN * ITEM_SIZE];
+    int literalCount = 0;
+    auto flushLiteral = [&]() {
+        if (literalCount == 0) return;
+        encoder.emit(OP_LITERAL | (literalCount - 1), literal, literalCount * ITEM_SIZE);
+        literalCount = 0;
+    };
+    
+    int i = 0;
+    while (i < count) {
+        uint8_t item[ITEM_SIZE];
+        itemAt(i, item);
+        
+        int run = 1;
+        uint8_t next[ITEM_SIZE];
+        while (i + run < count) {
+            itemAt(i + run, next);
+            if (memcmp(item, next, ITEM_SIZE) != 0) break;
+            run++;
+        }
+        
+        if (isSkip(item)) {
+            flushLiteral();
+            encoder.skip(run);
+        } else if (run >= 2) {
+            // Two equal items already cost no more as a repeat than as literals
+            flushLiteral();
+            for (int left = run; left > 0; left -= FRAME_CODEC_MAX_RUN) {
+                int chunk = left < FRAME_CODEC_MAX_RUN ? left : FRAME_CODEC_MAX_RUN;
+                encoder.emit(OP_REPEAT | (chunk - 1), item, ITEM_SIZE);
+            }
+        } else {
+            memcpy(literal + literalCount * ITEM_SIZE, item, ITEM_SIZE);
+            if (++literalCount == FRAME_CODEC_MAX_RUN) flushLiteral();
+        }
+        i += run;
+    }
+    flushLiteral();
+    return encoder.finish();
+}
+
+size_t encodeFrame(FrameCodecMode mode, const CRGB* frame, const CRGB* previous, int count,
+                   uint8_t* out, size_t capacity) {
+    if (mode == FrameCodecMode::DELTA_RLE) {
+        if (!previous) return 0;
+        auto itemAt = [&](int i, uint8_t* item) {
+            item[0] = frame[i].r ^ previous[i].r;
+            item[1] = frame[i].g ^ previous[i].g;
+            item[2] = frame[i].b ^ previous[i].b;
+        };
+        auto isSkip = [](const uint8_t* item) { return (item[0] | item[1] | item[2]) == 0; };
+        return encodeRuns<3>(count, itemAt, isSkip, out, capacity);
+    }
+    if (mode != FrameCodecMode::RLE) return 0;
+    auto itemAt = [&](int i, uint8_t* item) {
+        item[0] = frame[i].r;
+        item[1] = frame[i].g;
+        item[2] = frame[i].b;
+    };
+    auto never = [](const uint8_t*) { return false; };
+    return encodeRuns<3>(count, itemAt, never, out, capacity);
+}
+
+size_t encodeIndexedFrame(const uint8_t* indices, int count, uint8_t* out, size_t capacity) {
+    auto itemAt = [&](int i, uint8_t* item) { item[0] = indices[i]; };
+    auto never = [](const uint8_t*) { return false; };
+    return encodeRuns<1>(count, itemAt, never, out, capacity);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// Run-length coded pixel ranges. The payload is a sequence of ops, each a
+// control byte (2-bit tag, 6-bit n) followed by its items:
+//
+//   00nnnnnn  literal: n+1 items follow
+//   01nnnnnn  repeat: one item follows, used n+1 times
+//   10nnnnnn  skip n+1 pixels (left untouched)
+//   11nnnnnn  skip (n+1) * 64 pixels
+//
+// An item is a 3-byte r, g, b pixel, or a 1-byte palette index in INDEXED_RLE.
+// DELTA_RLE items are XORed into the destination, so a frame is sent as its
+// XOR against the previous one and unchanged spans collapse into skips.
+enum class FrameCodecMode : uint8_t {
+    RLE,
+    DELTA_RLE,
+    INDEXED_RLE
+};
+
+#define FRAME_CODEC_MAX_RUN 64
+
+// Decode into dst[0, count); returns false on malformed or overlong input
+bool decodeFrame(FrameCodecMode mode, const uint8_t* data, size_t length,
+                 CRGB* dst, int count, const CRGB* palette);
+
+// Encode count pixels (RLE: frame only, DELTA_RLE: XOR against previous).
+// Returns the encoded size, or 0 if it does not fit in capacity.
+size_t encodeFrame(FrameCodecMode mode, const CRGB* frame, const CRGB* previous, int count,
+                   uint8_t* out, size_t capacity);
+
+// INDEXED_RLE encoder for count palette indices
+size_t encodeIndexedFrame(const uint8_t* indices, int count, uint8_t* out, size_t capacity);
@@ -0,0 +1,11 @@
+#pragma once
+
+enum class AnimationType {
+    SOLID,
+    RAINBOW,
+    BREATHE,
+    THEATER_CHASE,
+    COLOR_WIPE,
+    RIPPLE,
+    STREAM      // Pixels come from the binary BLE stream, not an effect
+};
@@ -0,0 +1,49 @@
+#include "color_pipeline.h"
+
+// Dithering is only worth extra frames where one output step is a visible
+// fraction of the level, i.e. near black
+#define DITHER_LEVEL_LIMIT 48
+
+LedColorProfile colorProfileForLedType(const String& ledType) {
+    if (ledType == "SK6812") return LedColorProfile::SK6812;
+    if (ledType == "WS2811") return LedColorProfile::WS2811;
+    return LedColorProfile::WS2812B;
+}
+
+uint8_t nextDitherOffset() {
+    // 3-bit bit-reversed sequence spreads the offsets evenly over 8 frames
+    static const uint8_t sequence[8] = { 0, 128, 64, 192, 32, 160, 96, 224 };
+    static uint8_t frame = 0;
+    frame = (frame + 1) & 7;
+    return sequence[frame];
+}
+
+bool correctPixels(const CRGB* src, CRGB* dst, int count, const ColorLut& lut,
+                   uint16_t brightness16, uint8_t ditherOffset, uint32_t& channelSum) {
+    const uint16_t* red = lut.channel[0];
+    const uint16_t* green = lut.channel[1];
+    const uint16_t* blue = lut.channel[2];
+    uint32_t scale = (uint32_t)brightness16 + 1;
+    bool ditherVisible = false;
+    uint32_t sum = 0;
+    
+    for (int i = 0; i < count; i++) {
+        uint32_t r = (red[src[i].r] * scale) >> 16;
+        uint32_t g = (green[src[i].g] * scale) >> 16;
+        uint32_t b = (blue[src[i].b] * scale) >> 16;
+        
+        uint32_t outR = (r + ditherOffset) >> 8;
+        uint32_t outG = (g + ditherOffset) >> 8;
+        uint32_t outB = (b + ditherOffset) >> 8;
+        dst[i].r = outR > 255 ? 255 : outR;
+        dst[i].g = outG > 255 ? 255 : outG;
+        dst[i].b = outB > 255 ? 255 : outB;
+        sum += dst[i].r + dst[i].g + dst[i].b;
+        
+        ditherVisible |= ((r & 0xFF) && (r >> 8) < DITHER_LEVEL_LIMIT) ||
+                         ((g & 0xFF) && (g >> 8) < DITHER_LEVEL_LIMIT) ||
+                         ((b & 0xFF) && (b >> 8) < DITHER_LEVEL_LIMIT);
+    }
+    channelSum += sum;
+    return ditherVisible;
+}
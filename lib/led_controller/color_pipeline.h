@@ -0,0 +1,94 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// Gamma + white-balance correction applied between the render buffer and the
+// output buffers. Tables are generated by the compiler and live in flash.
+
+enum class LedColorProfile {
+    WS2812B,
+    SK6812,
+    WS2811
+};
+
+// 16-bit corrected intensity for each 8-bit channel value (R, G, B)
+struct ColorLut {
+    uint16_t channel[3][256];
+};
+
+namespace color_lut_detail {
+
+constexpr double LN2 = 0.69314718055994530942;
+
+// ln(x) for x > 0: reduce to [0.5, 1) then atanh series
+constexpr double log(double x) {
+    int exponent = 0;
+    while (x >= 1.0) { x *= 0.5; exponent++; }
+    while (x < 0.5) { x *= 2.0; exponent--; }
+    double y = (x - 1.0) / (x + 1.0);
+    double y2 = y * y;
+    double term = y;
+    double sum = 0.0;
+    for (int n = 1; n < 60; n += 2) {
+        sum += term / n;
+        term *= y2;
+    }
+    return 2.0 * sum + exponent * LN2;
+}
+
+// e^x for x <= 0: halve until small, Taylor, then square back up
+constexpr double exp(double x) {
+    int halvings = 0;
+    while (x < -0.5) { x *= 0.5; halvings++; }
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 20; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    while (halvings-- > 0) sum *= sum;
+    return sum;
+}
+
+constexpr ColorLut makeLut(double gamma, uint8_t whiteR, uint8_t whiteG, uint8_t whiteB) {
+    ColorLut lut{};
+    const uint8_t white[3] = { whiteR, whiteG, whiteB };
+    for (int c = 0; c < 3; c++) {
+        lut.channel[c][0] = 0;
+        for (int i = 1; i < 256; i++) {
+            double level = exp(gamma * log(i / 255.0));
+            lut.channel[c][i] = (uint16_t)(level * white[c] * 257.0 + 0.5);
+        }
+    }
+    return lut;
+}
+
+}  // namespace color_lut_detail
+
+// White points follow FastLED's TypicalSMD5050 / TypicalPixelString corrections
+inline constexpr ColorLut COLOR_LUTS[3] = {
+    color_lut_detail::makeLut(2.2, 255, 176, 240),  // WS2812B
+    color_lut_detail::makeLut(2.2, 255, 200, 235),  // SK6812
+    color_lut_detail::makeLut(2.2, 255, 224, 140),  // WS2811
+};
+
+static_assert(COLOR_LUTS[0].channel[0][255] == 65535, "full red must map to full scale");
+static_assert(COLOR_LUTS[0].channel[0][0] == 0, "black must stay black");
+
+LedColorProfile colorProfileForLedType(const String& ledType);
+
+inline const ColorLut& colorLutFor(LedColorProfile profile) {
+    return COLOR_LUTS[(int)profile];
+}
+
+// Ordered offset added below the 8-bit cut, cycled once per output frame
+uint8_t nextDitherOffset();
+
+// Correct `count` pixels from src into dst at 16-bit precision, scale by a
+// 16-bit brightness and round with the frame's dither offset. The sum of all
+// output channel values is added to channelSum. Returns true when dark pixels
+// sit between two output levels, i.e. further frames would still change what
+// the eye integrates.
+bool correctPixels(const CRGB* src, CRGB* dst, int count, const ColorLut& lut,
+                   uint16_t brightness16, uint8_t ditherOffset, uint32_t& channelSum);
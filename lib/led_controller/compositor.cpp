@@ -0,0 +1,124 @@
+#include "compositor.h"
+#include "pixel_blend.h"
+#include "effect_registry.h"
+
+Compositor::Compositor() : layerCount(0), generation(0), scratch(nullptr), numLeds(0),
+    lock(portMUX_INITIALIZER_UNLOCKED) {}
+
+bool Compositor::begin(int numLeds, FrameAllocator& pool) {
+    // One scratch buffer is shared by all layers; they render one at a time
+    scratch = pool.allocateArray<CRGB>("layer_scratch", numLeds);
+    this->numLeds = numLeds;
+    layerCount = 0;
+    return scratch != nullptr;
+}
+
+bool Compositor::setLayers(const LayerConfig* configs, int count) {
+    if (count < 0 || count > MAX_LAYERS) {
+        Serial.println("Invalid layer count: " + String(count));
+        return false;
+    }
+    
+    Layer loaded[MAX_LAYERS];
+    for (int i = 0; i < count; i++) {
+        LayerConfig config = configs[i];
+        // Clip the segment to the frame
+        if (config.start < 0) config.start = 0;
+        if (config.start >= numLeds || config.length <= 0) {
+            Serial.println("Layer " + String(i) + " is outside the strip");
+            return false;
+        }
+        if (config.start + config.length > numLeds) {
+            config.length = numLeds - config.start;
+        }
+        loaded[i].config = config;
+        resetEffectState(loaded[i].state);
+    }
+    
+    portENTER_CRITICAL(&lock);
+    memcpy(layers, loaded, count * sizeof(Layer));
+    layerCount = count;
+    generation++;
+    portEXIT_CRITICAL(&lock);
+    
+    Serial.println("Layers set: " + String(count));
+    return true;
+}
+
+void Compositor::clear() {
+    portENTER_CRITICAL(&lock);
+    layerCount = 0;
+    generation++;
+    portEXIT_CRITICAL(&lock);
+}
+
+static inline uint32_t blendNormal(uint32_t, uint32_t above) {
+    return above;
+}
+
+// One pass over a segment with the blend kernel fixed at compile time, so
+// the per-pixel loop has no mode dispatch
+template<uint32_t (*Blend)(uint32_t, uint32_t)>
+static void blendPass(CRGB* dst, const CRGB* src, int count, uint8_t opacity) {
+    if (opacity == 255) {
+        for (int i = 0; i < count; i++) {
+            dst[i] = unpackPixel(Blend(packPixel(dst[i]), packPixel(src[i])));
+        }
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        uint32_t below = packPixel(dst[i]);
+        dst[i] = unpackPixel(blendLerp(below, Blend(below, packPixel(src[i])), opacity));
+    }
+}
+
+void Compositor::blendSegment(CRGB* dst, const CRGB* src, int count, BlendMode mode, uint8_t opacity) {
+    switch (mode) {
+        case BlendMode::ADD:
+            blendPass<blendAdd>(dst, src, count, opacity);
+            break;
+        case BlendMode::MULTIPLY:
+            blendPass<blendMultiply>(dst, src, count, opacity);
+            break;
+        case BlendMode::MAX:
+            blendPass<blendMax>(dst, src, count, opacity);
+            break;
+        case BlendMode::NORMAL:
+        default:
+            if (opacity == 255) {
+                memcpy(dst, src, count * sizeof(CRGB));
+            } else {
+                blendPass<blendNormal>(dst, src, count, opacity);
+            }
+            break;
+    }
+}
+
+bool Compositor::render(CRGB* leds, const uint8_t* hueMap, const uint8_t* radiusMap, uint8_t brightness, uint32_t dtUs, uint32_t stepUs) {
+    Layer active[MAX_LAYERS];
+    portENTER_CRITICAL(&lock);
+    int count = layerCount;
+    uint32_t renderedGeneration = generation;
+    memcpy(active, layers, count * sizeof(Layer));
+    portEXIT_CRITICAL(&lock);
+    
+    for (int i = 0; i < count; i++) {
+        Layer& layer = active[i];
+        const LayerConfig& config = layer.config;
+        // Scratch holds another layer's pixels, so every layer redraws fully
+        EffectContext ctx = { scratch, hueMap + config.start, radiusMap + config.start, config.length,
+                              config.color, brightness, config.direction, true, dtUs, stepUs };
+        renderEffect(config.effect, ctx, layer.state);
+        blendSegment(leds + config.start, scratch, config.length, config.blendMode, config.opacity);
+    }
+    
+    // Write the advanced effect state back unless the layers were replaced meanwhile
+    portENTER_CRITICAL(&lock);
+    if (generation == renderedGeneration) {
+        for (int i = 0; i < count; i++) {
+            layers[i].state = active[i].state;
+        }
+    }
+    portEXIT_CRITICAL(&lock);
+    return count > 0;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "animation_type.h"
+#include "effects.h"
+#include "frame_allocator.h"
+
+#define MAX_LAYERS 4
+
+enum class BlendMode {
+    NORMAL,
+    ADD,
+    MULTIPLY,
+    MAX
+};
+
+struct LayerConfig {
+    int start;
+    int length;
+    AnimationType effect;
+    CRGB color;
+    uint8_t opacity;
+    BlendMode blendMode;
+    bool direction;
+};
+
+// Renders each layer's effect into a scratch buffer and blends it into its
+// segment of the frame, bottom layer first
+class Compositor {
+private:
+    struct Layer {
+        LayerConfig config;
+        EffectState state;
+    };
+    
+    Layer layers[MAX_LAYERS];
+    int layerCount;
+    uint32_t generation;    // Bumped whenever the layer set is replaced
+    CRGB* scratch;
+    int numLeds;
+    portMUX_TYPE lock;
+    
+    static void blendSegment(CRGB* dst, const CRGB* src, int count, BlendMode mode, uint8_t opacity);
+
+public:
+    Compositor();
+    
+    bool begin(int numLeds, FrameAllocator& pool);
+    bool setLayers(const LayerConfig* configs, int count);
+    void clear();
+    bool hasLayers() const { return layerCount > 0; }
+    int getLayerCount() const { return layerCount; }
+    
+    // Composite all layers over `leds`; returns true if anything was drawn
+    bool render(CRGB* leds, const uint8_t* hueMap, const uint8_t* radiusMap, uint8_t brightness, uint32_t dtUs, uint32_t stepUs);
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <Arduino.h>
+#include "animation_type.h"
+#include "effects.h"
+
+// Theme keys an effect reads, used to validate and apply theme commands
+#define EFFECT_PARAM_COLOR          0x01    // r, g, b
+#define EFFECT_PARAM_COLOR_DEFAULT  0x02    // Omitted color means white instead of "keep"
+#define EFFECT_PARAM_SPEED          0x04
+#define EFFECT_PARAM_DIRECTION      0x08
+#define EFFECT_EXTERNAL             0x80    // Pixels come from outside (not usable in scenes/layers)
+
+typedef bool (*EffectRenderFn)(const EffectContext& ctx, EffectState& state);
+
+struct EffectInfo {
+    const char* name;
+    AnimationType type;
+    EffectRenderFn render;
+    uint8_t params;
+};
+
+inline bool renderExternal(const EffectContext&, EffectState&) {
+    return false;
+}
+
+// One row per effect, in AnimationType order. Adding an effect means adding
+// its AnimationType value, its render function and a row here.
+inline constexpr EffectInfo EFFECTS[] = {
+    { "solid",          AnimationType::SOLID,          renderSolid,
+      EFFECT_PARAM_COLOR | EFFECT_PARAM_COLOR_DEFAULT },
+    { "rainbow",        AnimationType::RAINBOW,        renderRainbow,
+      EFFECT_PARAM_SPEED | EFFECT_PARAM_DIRECTION },
+    { "breathe",        AnimationType::BREATHE,        renderBreathe,
+      EFFECT_PARAM_COLOR | EFFECT_PARAM_SPEED },
+    { "theater_chase",  AnimationType::THEATER_CHASE,  renderTheaterChase,
+      EFFECT_PARAM_COLOR | EFFECT_PARAM_SPEED | EFFECT_PARAM_DIRECTION },
+    { "color_wipe",     AnimationType::COLOR_WIPE,     renderColorWipe,
+      EFFECT_PARAM_COLOR | EFFECT_PARAM_SPEED | EFFECT_PARAM_DIRECTION },
+    { "ripple",         AnimationType::RIPPLE,         renderRipple,
+      EFFECT_PARAM_COLOR | EFFECT_PARAM_SPEED | EFFECT_PARAM_DIRECTION },
+    { "stream",         AnimationType::STREAM,         renderExternal,
+      EFFECT_EXTERNAL },
+};
+
+inline constexpr size_t EFFECT_COUNT = sizeof(EFFECTS) / sizeof(EFFECTS[0]);
+
+constexpr bool effectTableMatchesEnum() {
+    for (size_t i = 0; i < EFFECT_COUNT; i++) {
+        if ((size_t)EFFECTS[i].type != i) return false;
+    }
+    return true;
+}
+static_assert(effectTableMatchesEnum(), "EFFECTS rows must be in AnimationType order");
+
+// Name lookup: FNV-1a with a seed searched at compile time so that every
+// effect name lands in its own slot (a perfect hash), then one strcmp
+#define EFFECT_HASH_SLOTS 16
+#define EFFECT_HASH_NO_SEED 0xFFFFFFFFu
+#define EFFECT_SLOT_EMPTY 0xFF
+
+constexpr uint32_t effectNameHash(const char* name, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+constexpr bool effectSeedIsPerfect(uint32_t seed) {
+    bool used[EFFECT_HASH_SLOTS] = {};
+    for (size_t i = 0; i < EFFECT_COUNT; i++) {
+        uint32_t slot = effectNameHash(EFFECTS[i].name, seed) % EFFECT_HASH_SLOTS;
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+constexpr uint32_t findEffectHashSeed() {
+    for (uint32_t seed = 0; seed < 4096; seed++) {
+        if (effectSeedIsPerfect(seed)) return seed;
+    }
+    return EFFECT_HASH_NO_SEED;
+}
+
+inline constexpr uint32_t EFFECT_HASH_SEED = findEffectHashSeed();
+static_assert(EFFECT_HASH_SEED != EFFECT_HASH_NO_SEED, "No perfect hash for the effect names, raise EFFECT_HASH_SLOTS");
+
+struct EffectSlotTable {
+    uint8_t index[EFFECT_HASH_SLOTS];
+};
+
+constexpr EffectSlotTable buildEffectSlots() {
+    EffectSlotTable table = {};
+    for (size_t i = 0; i < EFFECT_HASH_SLOTS; i++) table.index[i] = EFFECT_SLOT_EMPTY;
+    for (size_t i = 0; i < EFFECT_COUNT; i++) {
+        table.index[effectNameHash(EFFECTS[i].name, EFFECT_HASH_SEED) % EFFECT_HASH_SLOTS] = i;
+    }
+    return table;
+}
+
+inline constexpr EffectSlotTable EFFECT_SLOTS = buildEffectSlots();
+
+// nullptr for unknown names
+inline const EffectInfo* findEffect(const char* name) {
+    uint8_t index = EFFECT_SLOTS.index[effectNameHash(name, EFFECT_HASH_SEED) % EFFECT_HASH_SLOTS];
+    if (index == EFFECT_SLOT_EMPTY || strcmp(EFFECTS[index].name, name) != 0) return nullptr;
+    return &EFFECTS[index];
+}
+
+// A theme command's "mode": effect is nullptr when there is none (the command
+// only sets scalar keys such as brightness or fps); false for unknown names
+inline bool findThemeEffect(const char* mode, const EffectInfo*& effect) {
+    effect = mode ? findEffect(mode) : nullptr;
+    return !mode || effect;
+}
+
+inline const EffectInfo& effectInfo(AnimationType type) {
+    return EFFECTS[(size_t)type];
+}
+
+// Render one frame of `type`: a table call, no per-frame dispatch on the type
+inline bool renderEffect(AnimationType type, const EffectContext& ctx, EffectState& state) {
+    return EFFECTS[(size_t)type].render(ctx, state);
+}
@@ -0,0 +1,126 @@
+#include "effects.h"
+
+// Full-saturation rainbow, so the per-pixel loop is a table load instead of hsv2rgb
+static CRGB rainbowTable[256];
+static bool rainbowTableReady = false;
+
+static void buildRainbowTable() {
+    for (int hue = 0; hue < 256; hue++) {
+        hsv2rgb_rainbow(CHSV(hue, 255, 255), rainbowTable[hue]);
+    }
+    rainbowTableReady = true;
+}
+
+void resetEffectState(EffectState& state) {
+    state.index = 0;
+    state.phase = 0;
+    state.level = 0;
+    state.elapsedUs = 0;
+}
+
+uint32_t advanceSteps(const EffectContext& ctx, EffectState& state) {
+    uint32_t stepUs = ctx.stepUs > 0 ? ctx.stepUs : 1;
+    state.elapsedUs += ctx.dtUs;
+    if (state.elapsedUs < stepUs) return 0;
+    // One divide per frame; effects then move by whole steps
+    uint32_t steps = state.elapsedUs / stepUs;
+    state.elapsedUs -= steps * stepUs;
+    return steps;
+}
+
+bool renderSolid(const EffectContext& ctx, EffectState&) {
+    // Static effect: only redraw after a color/animation/brightness change
+    if (!ctx.force) return false;
+    fill_solid(ctx.leds, ctx.count, ctx.color);
+    return true;
+}
+
+bool renderRainbow(const EffectContext& ctx, EffectState& state) {
+    uint32_t steps = advanceSteps(ctx, state);
+    state.index = (uint8_t)(state.index + (ctx.direction ? steps : -steps));
+    if (steps == 0 && !ctx.force) return false;
+    
+    if (!rainbowTableReady) buildRainbowTable();
+    uint8_t baseHue = state.index;
+    for (int i = 0; i < ctx.count; i++) {
+        ctx.leds[i] = rainbowTable[(uint8_t)(baseHue + ctx.hueMap[i])];
+    }
+    return true;
+}
+
+bool renderBreathe(const EffectContext& ctx, EffectState& state) {
+    uint32_t steps = advanceSteps(ctx, state);
+    state.index = (uint8_t)(state.index + (ctx.direction ? 2 * steps : -2 * steps));
+    uint8_t level = scale8(sin8(state.index), ctx.brightness);
+    if (level == state.level && !ctx.force) return false;
+    state.level = level;
+    
+    // Scale the color once per frame; every pixel gets the same value
+    CRGB color = ctx.color;
+    color.nscale8(level);
+    fill_solid(ctx.leds, ctx.count, color);
+    return true;
+}
+
+bool renderTheaterChase(const EffectContext& ctx, EffectState& state) {
+    uint32_t steps = advanceSteps(ctx, state) % 3;
+    if (ctx.direction) {
+        state.phase = (state.phase + steps) % 3;
+    } else {
+        state.phase = (state.phase + 3 - steps) % 3;
+    }
+    if (steps == 0 && !ctx.force) return false;
+    
+    // Clear, then stride over the lit pixels: a per-pixel select between
+    // lit and black measured slower than the two simple store loops
+    fill_solid(ctx.leds, ctx.count, CRGB::Black);
+    for (int i = state.phase; i < ctx.count; i += 3) {
+        ctx.leds[i] = ctx.color;
+    }
+    return true;
+}
+
+bool renderColorWipe(const EffectContext& ctx, EffectState& state) {
+    // The index may come from another effect's state or a longer segment
+    if (state.index > ctx.count) state.index = ctx.count;
+    // Incremental: relies on the previous frame still being in the buffer
+    // unless a forced redraw asks for the whole wiped prefix again
+    if (ctx.force) {
+        fill_solid(ctx.leds, state.index, ctx.color);
+        fill_solid(ctx.leds + state.index, ctx.count - state.index, CRGB::Black);
+    }
+    // One pixel per step, however many steps this frame covers
+    uint32_t steps = advanceSteps(ctx, state);
+    if (ctx.direction) {
+        uint32_t remaining = ctx.count - state.index;
+        if (steps > remaining) steps = remaining;
+        if (steps > 0) {
+            fill_solid(ctx.leds + state.index, steps, ctx.color);
+            state.index += steps;
+            return true;
+        }
+    } else {
+        if (steps > state.index) steps = state.index;
+        if (steps > 0) {
+            state.index -= steps;
+            fill_solid(ctx.leds + state.index, steps, CRGB::Black);
+            return true;
+        }
+    }
+    return ctx.force;
+}
+
+bool renderRipple(const EffectContext& ctx, EffectState& state) {
+    uint32_t steps = advanceSteps(ctx, state);
+    state.index = (uint8_t)(state.index + (ctx.direction ? 4 * steps : -4 * steps));
+    if (steps == 0 && !ctx.force) return false;
+    
+    // Rings of the color travel outwards from the center of the layout
+    uint8_t wave = state.index;
+    for (int i = 0; i < ctx.count; i++) {
+        CRGB pixel = ctx.color;
+        pixel.nscale8(sin8((uint8_t)(ctx.radiusMap[i] - wave)));
+        ctx.leds[i] = pixel;
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "animation_type.h"
+
+// Everything an effect kernel needs to draw one frame into a pixel range
+struct EffectContext {
+    CRGB* leds;
+    const uint8_t* hueMap;  // Per-pixel rainbow hue offset for the same range
+    const uint8_t* radiusMap;   // Per-pixel distance from the layout's center
+    int count;
+    CRGB color;
+    uint8_t brightness;
+    bool direction;
+    bool force;             // Redraw even if the effect's output would not change
+    uint32_t dtUs;          // Time since the previous frame
+    uint32_t stepUs;        // Animation speed: time per animation step
+};
+
+// Per-instance animation state, so the same effect can run on several layers
+struct EffectState {
+    uint16_t index;
+    uint8_t phase;
+    uint8_t level;
+    uint32_t elapsedUs;     // Time carried over towards the next step
+};
+
+void resetEffectState(EffectState& state);
+
+// Whole animation steps due after ctx.dtUs, keeping the remainder in state
+uint32_t advanceSteps(const EffectContext& ctx, EffectState& state);
+
+// Effect kernels; each returns true when the pixels changed.
+// Dispatch by type goes through effect_registry.h.
+bool renderSolid(const EffectContext& ctx, EffectState& state);
+bool renderRainbow(const EffectContext& ctx, EffectState& state);
+bool renderBreathe(const EffectContext& ctx, EffectState& state);
+bool renderTheaterChase(const EffectContext& ctx, EffectState& state);
+bool renderColorWipe(const EffectContext& ctx, EffectState& state);
+bool renderRipple(const EffectContext& ctx, EffectState& state);
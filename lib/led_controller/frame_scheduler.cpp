@@ -0,0 +1,87 @@
+#include "frame_scheduler.h"
+
+FrameScheduler::FrameScheduler() : periodUs(1000000UL / DEFAULT_TARGET_FPS),
+    nextDeadline(0), lastFrameStart(0), started(false), retimed(false) {
+    resetStats();
+}
+
+void FrameScheduler::setTargetFps(uint16_t fps) {
+    if (fps == 0) fps = 1;
+    if (fps > 1000) fps = 1000;
+    periodUs = 1000000UL / fps;
+    // Keep the last frame start so the next dt is real; only the deadline
+    // moves to the new period
+    nextDeadline = lastFrameStart + periodUs;
+    retimed = started;
+}
+
+uint32_t FrameScheduler::timeUntilNextFrame(uint32_t nowUs) const {
+    if (!started) return 0;
+    int32_t remaining = (int32_t)(nextDeadline - nowUs);
+    return remaining > 0 ? remaining : 0;
+}
+
+int FrameScheduler::bucketFor(uint32_t latenessUs) {
+    int bucket = 0;
+    uint32_t limit = 250;
+    while (bucket < JITTER_BUCKETS - 1 && latenessUs >= limit) {
+        limit <<= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+uint32_t FrameScheduler::beginFrame(uint32_t nowUs) {
+    if (!started) {
+        started = true;
+        lastFrameStart = nowUs;
+        nextDeadline = nowUs + periodUs;
+        framesStarted++;
+        return 0;
+    }
+    
+    // Lateness against a deadline from the old rate is not a dropped frame
+    // (a jump from 1 to 60 fps would count dozens), so the first frame after
+    // a rate change just starts the new cadence
+    if (retimed) {
+        retimed = false;
+        uint32_t dt = nowUs - lastFrameStart;
+        lastFrameStart = nowUs;
+        nextDeadline = nowUs + periodUs;
+        framesStarted++;
+        return dt;
+    }
+    
+    uint32_t lateness = (int32_t)(nowUs - nextDeadline) > 0 ? nowUs - nextDeadline : 0;
+    jitterHistogram[bucketFor(lateness)]++;
+    if (lateness > maxLatenessUs) maxLatenessUs = lateness;
+    
+    // A whole period late means those frames never happened: count them and
+    // move on to the next deadline in the future instead of bursting to catch up
+    uint32_t missed = lateness / periodUs;
+    framesDropped += missed;
+    nextDeadline += (missed + 1) * periodUs;
+    
+    uint32_t dt = nowUs - lastFrameStart;
+    lastFrameStart = nowUs;
+    framesStarted++;
+    return dt;
+}
+
+void FrameScheduler::resetStats() {
+    framesStarted = 0;
+    framesDropped = 0;
+    maxLatenessUs = 0;
+    memset(jitterHistogram, 0, sizeof(jitterHistogram));
+}
+
+void FrameScheduler::writeStats(JsonObject stats) const {
+    stats["target_fps"] = getTargetFps();
+    stats["frames"] = framesStarted;
+    stats["dropped"] = framesDropped;
+    stats["max_late_us"] = maxLatenessUs;
+    JsonArray histogram = stats["jitter"].to<JsonArray>();
+    for (int i = 0; i < JITTER_BUCKETS; i++) {
+        histogram.add(jitterHistogram[i]);
+    }
+}
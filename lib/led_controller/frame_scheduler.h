@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#define DEFAULT_TARGET_FPS 60
+#define JITTER_BUCKETS 8
+
+// Fixed-rate frame deadlines with drop accounting. Lateness against each
+// deadline goes into a log2 histogram: <250us, <500us, <1ms, <2ms, <4ms,
+// <8ms, <16ms, >=16ms.
+class FrameScheduler {
+private:
+    uint32_t periodUs;
+    uint32_t nextDeadline;
+    uint32_t lastFrameStart;
+    bool started;
+    bool retimed;       // Rate changed since the last frame
+    
+    uint32_t framesStarted;
+    uint32_t framesDropped;
+    uint32_t maxLatenessUs;
+    uint32_t jitterHistogram[JITTER_BUCKETS];
+    
+    static int bucketFor(uint32_t latenessUs);
+
+public:
+    FrameScheduler();
+    
+    void setTargetFps(uint16_t fps);
+    uint16_t getTargetFps() const { return 1000000UL / periodUs; }
+    
+    // Microseconds until the next frame is due (0 when due or late)
+    uint32_t timeUntilNextFrame(uint32_t nowUs) const;
+    
+    // Start a frame: records lateness, skips deadlines that were missed
+    // entirely, and returns the time since the previous frame in us
+    uint32_t beginFrame(uint32_t nowUs);
+    
+    void resetStats();
+    void writeStats(JsonObject stats) const;
+};
@@ -1,155 +1,529 @@
 #include "led_controller.h"
+#include "profiler.h"
 
-LEDController::LEDController() : leds(nullptr), numLeds(0), ledPin(2), 
+LEDController::LEDController() : leds(nullptr), frontBuffer(nullptr), backBuffer(nullptr),
+    stripCount(0), hueMap(nullptr), radiusMap(nullptr), numLeds(0), 
     currentAnimation(AnimationType::SOLID), currentColor(CRGB::Black),
     brightness(128), animationSpeed(50), animationDirection(true),
-    lastUpdate(0), animationIndex(0) {}
+    frameDirty(true), framesShown(0), framesSkipped(0), firstFrameUs(0),
+    ditherPending(false), backPowerScale(255), frontPowerScale(255), totalDrawMa(0),
+    framePending(false), pipelineRunning(false),
+    renderTaskHandle(nullptr), outputTaskHandle(nullptr),
+    streamSelected(false), controlLock(portMUX_INITIALIZER_UNLOCKED),
+    streamRx(nullptr), streamFrame(nullptr), streamTaken(nullptr), streamPalette(nullptr), streamFrameReady(false),
+    streamPackets(0), streamFrames(0), streamErrors(0),
+    streamWindowStart(0), streamWindowFrames(0), streamFps(0),
+    streamLock(portMUX_INITIALIZER_UNLOCKED) {
+    resetEffectState(effectState);
+}
+
+// Frame buffers belong to bufferPool and are released with it
+LEDController::~LEDController() {}
+
+bool LEDController::beginBufferPool(size_t internalBytes, size_t psramBytes) {
+    return bufferPool.begin(internalBytes, psramBytes);
+}
+
+// Precompute the strip's coordinate tables so effects only do table lookups per pixel
+bool LEDController::buildTopology(LEDStrip& strip) {
+    const LEDStripConfig& config = strip.config;
+    TopologyType type = topologyFromDeviceType(config.deviceType);
+    TopologyConfig topology = { type, config.numLeds, config.matrixWidth, config.serpentine, config.coords };
+    strip.xyTable = nullptr;
+    strip.width = config.numLeds;
+    strip.height = 1;
+    
+    if (type == TopologyType::MATRIX) {
+        strip.width = config.matrixWidth > 0 ? config.matrixWidth : config.numLeds;
+        strip.height = (config.numLeds + strip.width - 1) / strip.width;
+        int cells = strip.width * strip.height;
+        strip.xyTable = bufferPool.allocateArray<uint16_t>("xy_table", cells);
+        if (!strip.xyTable) return false;
+        // A partly filled last row leaves holes
+        for (int i = 0; i < cells; i++) strip.xyTable[i] = 0xFFFF;
+    } else if (type == TopologyType::CUSTOM && !config.coords) {
+        Serial.println("Custom topology without coordinates, using strip layout");
+    }
+    
+    TopologyMaps maps = { hueMap + strip.offset, radiusMap + strip.offset, strip.xyTable };
+    buildTopologyMaps(topology, maps);
+    return true;
+}
+
+int LEDController::xyToIndex(int strip, int x, int y) const {
+    if (strip < 0 || strip >= stripCount) return -1;
+    const LEDStrip& s = strips[strip];
+    if (!s.xyTable || x < 0 || y < 0 || x >= s.width || y >= s.height) return -1;
+    uint16_t index = s.xyTable[y * s.width + x];
+    return index == 0xFFFF ? -1 : s.offset + index;
+}
+
+// FastLED needs the data pin as a template argument, so map the runtime pin
+// onto the GPIOs that are valid outputs on both the ESP32 and the ESP32-S3
+template<template<uint8_t DATA_PIN, EOrder RGB_ORDER> class CHIPSET, EOrder RGB_ORDER>
+static CLEDController* addLedsOnPin(int pin, CRGB* data, int count) {
+#define LED_PIN_CASE(p) case p: return &FastLED.addLeds<CHIPSET, p, RGB_ORDER>(data, count);
+    switch (pin) {
+        LED_PIN_CASE(2)
+        LED_PIN_CASE(4)
+        LED_PIN_CASE(5)
+        LED_PIN_CASE(12)
+        LED_PIN_CASE(13)
+        LED_PIN_CASE(14)
+        LED_PIN_CASE(15)
+        LED_PIN_CASE(16)
+        LED_PIN_CASE(17)
+        LED_PIN_CASE(18)
+        LED_PIN_CASE(19)
+        LED_PIN_CASE(21)
+    }
+#undef LED_PIN_CASE
+    return nullptr;
+}
+
+CLEDController* LEDController::addStripOutput(const LEDStripConfig& config, CRGB* data) {
+    // Configure FastLED based on LED type
+    if (config.ledType == "SK6812") {
+        return addLedsOnPin<SK6812, GRB>(config.pin, data, config.numLeds);
+    } else if (config.ledType == "WS2811") {
+        return addLedsOnPin<WS2811, RGB>(config.pin, data, config.numLeds);
+    }
+    // Default to WS2812B
+    return addLedsOnPin<WS2812B, GRB>(config.pin, data, config.numLeds);
+}
+
+bool LEDController::usesPin(int pin) const {
+    for (int i = 0; i < stripCount; i++) {
+        if (strips[i].config.pin == pin) return true;
+    }
+    return false;
+}
 
-LEDController::~LEDController() {
-    if (leds) {
-        delete[] leds;
+// Point every strip's controller at its slice of an output buffer
+void LEDController::bindOutputs(CRGB* buffer) {
+    for (int i = 0; i < stripCount; i++) {
+        if (!strips[i].output) continue;
+        strips[i].output->setLeds(buffer + strips[i].offset, strips[i].config.numLeds);
     }
 }
 
 bool LEDController::initialize(const String& ledType, int numLeds, int pin) {
-    this->numLeds = numLeds;
-    this->ledPin = pin;
-    this->ledType = ledType;
+    LEDStripConfig config = { ledType, numLeds, pin };
+    return initialize(&config, 1);
+}
+
+bool LEDController::initialize(const LEDStripConfig* configs, int count) {
+    if (pipelineRunning) {
+        Serial.println("Cannot re-initialize LEDs while the render pipeline is running");
+        return false;
+    }
+    if (count > MAX_LED_STRIPS) {
+        Serial.println("Too many LED strips, using the first " + String(MAX_LED_STRIPS));
+        count = MAX_LED_STRIPS;
+    }
+    
+    stripCount = 0;
+    numLeds = 0;
+    for (int i = 0; i < count; i++) {
+        if (configs[i].numLeds <= 0) continue;
+        strips[stripCount].config = configs[i];
+        strips[stripCount].offset = numLeds;
+        strips[stripCount].output = nullptr;
+        numLeds += configs[i].numLeds;
+        stripCount++;
+    }
+    if (stripCount == 0) {
+        Serial.println("No LED strips configured");
+        return false;
+    }
+    if (numLeds > MAX_FRAME_LEDS) {
+        Serial.println(String(numLeds) + " LEDs is more than the frame pool is sized for (" +
+                       String(MAX_FRAME_LEDS) + ")");
+    }
     
-    if (leds) {
-        delete[] leds;
+    // Re-configuration reuses the same arenas instead of going back to the heap.
+    // Output buffers are read by the RMT driver while SPIFFS writes can have the
+    // flash cache (and with it PSRAM) disabled, so they stay in internal SRAM,
+    // and so does the render buffer every effect works in.
+    bufferPool.reset();
+    frontBuffer = bufferPool.allocateArray<CRGB>("front", numLeds, BufferPlacement::INTERNAL);
+    backBuffer = bufferPool.allocateArray<CRGB>("back", numLeds, BufferPlacement::INTERNAL);
+    hueMap = bufferPool.allocateArray<uint8_t>("hue_map", numLeds, BufferPlacement::INTERNAL);
+    radiusMap = bufferPool.allocateArray<uint8_t>("radius_map", numLeds, BufferPlacement::INTERNAL);
+    leds = bufferPool.allocateArray<CRGB>("render", numLeds, BufferPlacement::INTERNAL);
+    streamRx = bufferPool.allocateArray<CRGB>("stream_rx", numLeds);
+    streamFrame = bufferPool.allocateArray<CRGB>("stream_frame", numLeds);
+    streamTaken = bufferPool.allocateArray<CRGB>("stream_taken", numLeds);
+    streamPalette = bufferPool.allocateArray<CRGB>("stream_palette", PIXEL_STREAM_PALETTE_SIZE);
+    if (!frontBuffer || !backBuffer || !hueMap || !radiusMap || !leds || !compositor.begin(numLeds, bufferPool) ||
+        !transition.begin(numLeds, bufferPool) || !streamRx || !streamFrame || !streamTaken || !streamPalette) {
+        Serial.println("Not enough frame buffer memory for " + String(numLeds) + " LEDs");
+        leds = nullptr;
+        stripCount = 0;
+        numLeds = 0;
+        return false;
     }
-    leds = new CRGB[numLeds];
+    fill_solid(frontBuffer, numLeds, CRGB::Black);
+    fill_solid(backBuffer, numLeds, CRGB::Black);
+    fill_solid(streamRx, numLeds, CRGB::Black);
+    fill_solid(streamFrame, numLeds, CRGB::Black);
+    fill_solid(streamTaken, numLeds, CRGB::Black);
+    fill_solid(streamPalette, PIXEL_STREAM_PALETTE_SIZE, CRGB::Black);
+    streamFrameReady = false;
+    framePending.store(false);
     
-    // Configure FastLED based on LED type
-    if (ledType == "WS2812B") {
-        FastLED.addLeds<WS2812B, 2, GRB>(leds, numLeds);
-    } else if (ledType == "SK6812") {
-        FastLED.addLeds<SK6812, 2, GRB>(leds, numLeds);
-    } else if (ledType == "WS2811") {
-        FastLED.addLeds<WS2811, 2, RGB>(leds, numLeds);
-    } else {
-        // Default to WS2812B
-        FastLED.addLeds<WS2812B, 2, GRB>(leds, numLeds);
-    }
-    
-    FastLED.setBrightness(brightness);
+    // Every strip is its own FastLED controller showing a slice of the front
+    // buffer; on the ESP32 the RMT driver clocks all of them out in parallel
+    // from a single FastLED.show()
+    for (int i = 0; i < stripCount; i++) {
+        LEDStrip& strip = strips[i];
+        strip.output = addStripOutput(strip.config, frontBuffer + strip.offset);
+        strip.colorLut = &colorLutFor(colorProfileForLedType(strip.config.ledType));
+        strip.drawMa = 0;
+        if (!strip.output) {
+            // Keep the slice so offsets stay valid, it just isn't sent anywhere
+            Serial.println("Unsupported LED data pin " + String(strip.config.pin) +
+                           " for strip " + String(i) + ", strip disabled");
+        }
+        if (!buildTopology(strip)) {
+            Serial.println("Not enough memory for the layout table of strip " + String(i));
+            strip.config.deviceType = "strip";
+            buildTopology(strip);
+        }
+        strip.config.coords = nullptr;
+    }
+    
+    // Brightness, gamma and dithering are applied by correctPixels() at 16-bit
+    // precision, so FastLED passes the output buffers through untouched
+    FastLED.setBrightness(255);
+    FastLED.setDither(DISABLE_DITHER);
     clear();
     show();
+    frameDirty = true;
     
-    Serial.println("LED Controller initialized: " + ledType + " (" + String(numLeds) + " LEDs)");
+    for (int i = 0; i < stripCount; i++) {
+        if (!strips[i].output) continue;
+        Serial.println("LED strip " + String(i) + " initialized: " + strips[i].config.ledType +
+                       " (" + String(strips[i].config.numLeds) + " LEDs) on pin " + String(strips[i].config.pin));
+    }
     return true;
 }
 
-void LEDController::setAnimation(AnimationType type) {
+// Render task only; other tasks go through postControl()
+void LEDController::resetAnimation(AnimationType type) {
     currentAnimation = type;
-    animationIndex = 0;
-    Serial.println("Animation set to: " + String((int)type));
+    resetEffectState(effectState);
+    frameDirty = true;
+}
+
+// Any task: merge a change into the pending one, later values win
+void LEDController::postControl(const ControlChange& change) {
+    portENTER_CRITICAL(&controlLock);
+    ControlChange& pending = pendingControl;
+    if (change.flags & CONTROL_EFFECT) {
+        pending.animation = change.animation;
+        streamSelected = change.animation == AnimationType::STREAM;
+    }
+    if (change.flags & CONTROL_COLOR) pending.color = change.color;
+    if (change.flags & CONTROL_BRIGHTNESS) pending.brightness = change.brightness;
+    if (change.flags & CONTROL_SPEED) pending.speed = change.speed;
+    if (change.flags & CONTROL_DIRECTION) pending.direction = change.direction;
+    if (change.flags & CONTROL_FPS) pending.fps = change.fps;
+    pending.flags |= change.flags;
+    portEXIT_CRITICAL(&controlLock);
+}
+
+// Render task: apply what was posted since the last frame
+void LEDController::applyControl() {
+    portENTER_CRITICAL(&controlLock);
+    ControlChange change = pendingControl;
+    pendingControl.flags = 0;
+    portEXIT_CRITICAL(&controlLock);
+    if (change.flags == 0) return;
+    
+    if (change.flags & CONTROL_FPS) scheduler.setTargetFps(change.fps);
+    if (change.flags & CONTROL_BRIGHTNESS) brightness = change.brightness;
+    if (change.flags & CONTROL_SPEED) animationSpeed = change.speed;
+    if (change.flags & CONTROL_DIRECTION) animationDirection = change.direction;
+    
+    AnimationType effect = (change.flags & CONTROL_EFFECT) ? change.animation : currentAnimation;
+    CRGB color = (change.flags & CONTROL_COLOR) ? change.color : currentColor;
+    if ((change.flags & CONTROL_TRANSITION) && (effect != currentAnimation || color != currentColor)) {
+        transition.start(currentAnimation, currentColor, effectState);
+    }
+    currentColor = color;
+    if (change.flags & CONTROL_EFFECT) {
+        resetAnimation(effect);
+    }
+    frameDirty = true;
+}
+
+void LEDController::setAnimation(AnimationType type) {
+    ControlChange change;
+    change.flags = CONTROL_EFFECT;
+    change.animation = type;
+    postControl(change);
+    Serial.println("Animation set to: " + String(effectInfo(type).name));
 }
 
 void LEDController::setSolidColor(uint8_t r, uint8_t g, uint8_t b) {
-    currentColor = CRGB(r, g, b);
-    setAnimation(AnimationType::SOLID);
+    ControlChange change;
+    change.flags = CONTROL_EFFECT | CONTROL_COLOR;
+    change.animation = AnimationType::SOLID;
+    change.color = CRGB(r, g, b);
+    postControl(change);
+    Serial.println("Animation set to: " + String(effectInfo(AnimationType::SOLID).name));
 }
 
 void LEDController::setBrightness(uint8_t brightness) {
-    this->brightness = brightness;
-    FastLED.setBrightness(brightness);
+    ControlChange change;
+    change.flags = CONTROL_BRIGHTNESS;
+    change.brightness = brightness;
+    postControl(change);
     Serial.println("Brightness set to: " + String(brightness));
 }
 
 void LEDController::setSpeed(uint16_t speed) {
-    this->animationSpeed = speed;
+    ControlChange change;
+    change.flags = CONTROL_SPEED;
+    change.speed = speed;
+    postControl(change);
 }
 
 void LEDController::setDirection(bool forward) {
-    this->animationDirection = forward;
+    ControlChange change;
+    change.flags = CONTROL_DIRECTION;
+    change.direction = forward;
+    postControl(change);
+}
+
+void LEDController::setTargetFps(uint16_t fps) {
+    if (fps == 0) fps = 1;
+    if (fps > 1000) fps = 1000;
+    ControlChange change;
+    change.flags = CONTROL_FPS;
+    change.fps = fps;
+    postControl(change);
+    Serial.println("Target FPS set to: " + String(fps));
 }
 
 void LEDController::update() {
-    if (millis() - lastUpdate < animationSpeed) {
+    // The render task drives the effects once the pipeline is running
+    if (pipelineRunning) return;
+    
+    if (scheduler.timeUntilNextFrame(micros()) > 0) {
         return;
     }
     
-    switch (currentAnimation) {
-        case AnimationType::SOLID:
-            updateSolid();
-            break;
-        case AnimationType::RAINBOW:
-            updateRainbow();
-            break;
-        case AnimationType::BREATHE:
-            updateBreathe();
-            break;
-        case AnimationType::THEATER_CHASE:
-            updateTheaterChase();
-            break;
-        case AnimationType::COLOR_WIPE:
-            updateColorWipe();
-            break;
+    uint32_t dtUs = scheduler.beginFrame(micros());
+    if (renderFrame(dtUs)) {
+        publishFrame();
+        presentFrame();
+    }
+}
+
+// Advance the current effect by dtUs into the render buffer; true if a new frame must be shown
+bool LEDController::renderFrame(uint32_t dtUs) {
+    PROFILE_SCOPE(ProfileStage::RENDER);
+    applyControl();
+    if (scene.isPlaying()) {
+        applyScene();
     }
     
-    show();
-    lastUpdate = millis();
+    // Layers are blended on top of the base frame, so with layers active the
+    // base has to be redrawn from scratch every frame. The same goes for the
+    // blended frames of a transition.
+    bool layered = compositor.hasLayers();
+    bool transitioning = transition.isActive();
+    uint32_t stepUs = animationSpeed * 1000UL;
+    EffectContext ctx = { leds, hueMap, radiusMap, numLeds, currentColor, brightness,
+                          animationDirection, frameDirty || layered || transitioning, dtUs, stepUs };
+    bool changed = currentAnimation == AnimationType::STREAM
+        ? takeStreamFrame(ctx.force)
+        : renderEffect(currentAnimation, ctx, effectState);
+    if (transitioning) {
+        changed |= transition.render(leds, ctx);
+    }
+    if (layered) {
+        changed |= compositor.render(leds, hueMap, radiusMap, brightness, dtUs, stepUs);
+    }
+    
+    if (changed || frameDirty || ditherPending) {
+        frameDirty = false;
+        return true;
+    }
+    framesSkipped++;
+    return false;
 }
 
-void LEDController::updateSolid() {
-    for (int i = 0; i < numLeds; i++) {
-        leds[i] = currentColor;
+// Pull the current scene parameters; only real changes mark the frame dirty
+void LEDController::applyScene() {
+    SceneState state;
+    state.keyframe = -1;
+    scene.evaluate(millis(), state);
+    if (state.keyframe < 0) return;
+    
+    if (state.effect != currentAnimation) {
+        transition.start(currentAnimation, currentColor, effectState);
+        resetAnimation(state.effect);
+    }
+    if (state.color != currentColor) {
+        currentColor = state.color;
+        frameDirty = true;
     }
+    if (state.brightness != brightness) {
+        brightness = state.brightness;
+        frameDirty = true;
+    }
+    animationSpeed = state.speed;
+}
+
+void LEDController::stopScene() {
+    scene.stop();
 }
 
-void LEDController::updateRainbow() {
-    for (int i = 0; i < numLeds; i++) {
-        leds[i] = CHSV((animationIndex + i * 255 / numLeds) % 255, 255, 255);
+// Render side: color-correct the finished frame into the back buffer and hand it over
+void LEDController::publishFrame() {
+    uint16_t brightness16 = brightness * 257;
+    uint8_t ditherOffset = nextDitherOffset();
+    bool dither = false;
+    for (int i = 0; i < stripCount; i++) {
+        LEDStrip& strip = strips[i];
+        // The channel sum falls out of the correction pass, so the current
+        // estimate costs no extra scan and is only redone when a frame changes
+        uint32_t channelSum = 0;
+        dither |= correctPixels(leds + strip.offset, backBuffer + strip.offset,
+                                strip.config.numLeds, *strip.colorLut, brightness16, ditherOffset,
+                                channelSum);
+        strip.drawMa = channelSum * LED_MA_PER_CHANNEL / 255 + strip.config.numLeds * LED_IDLE_MA;
     }
-    animationIndex = (animationIndex + (animationDirection ? 1 : -1)) % 255;
+    ditherPending = dither;
+    backPowerScale = computePowerScale();
+    framePending.store(true, std::memory_order_release);
 }
 
-void LEDController::updateBreathe() {
-    uint8_t breatheValue = (sin8(animationIndex) / 255.0) * brightness;
-    for (int i = 0; i < numLeds; i++) {
-        leds[i] = currentColor;
-        leds[i].nscale8(breatheValue);
+// Largest output scale that keeps every strip within its budget
+uint8_t LEDController::computePowerScale() {
+    uint32_t scale = 255;
+    uint32_t total = 0;
+    for (int i = 0; i < stripCount; i++) {
+        const LEDStrip& strip = strips[i];
+        uint32_t budget = strip.config.powerBudgetMa;
+        uint32_t idle = strip.config.numLeds * LED_IDLE_MA;
+        if (budget > 0 && strip.drawMa > budget) {
+            uint32_t dynamic = strip.drawMa - idle;
+            uint32_t allowed = budget > idle ? budget - idle : 0;
+            uint32_t stripScale = dynamic > 0 ? allowed * 255 / dynamic : 255;
+            if (stripScale < scale) scale = stripScale;
+        }
+    }
+    for (int i = 0; i < stripCount; i++) {
+        const LEDStrip& strip = strips[i];
+        uint32_t idle = strip.config.numLeds * LED_IDLE_MA;
+        total += (strip.drawMa - idle) * scale / 255 + idle;
     }
-    animationIndex += animationDirection ? 2 : -2;
+    totalDrawMa = total;
+    return scale;
 }
 
-void LEDController::updateTheaterChase() {
-    clear();
-    for (int i = animationIndex % 3; i < numLeds; i += 3) {
-        leds[i] = currentColor;
+// Output side: swap the published frame to the front and push it to the strip
+void LEDController::presentFrame() {
+    CRGB* published = backBuffer;
+    backBuffer = frontBuffer;
+    frontBuffer = published;
+    bindOutputs(frontBuffer);
+    frontPowerScale = backPowerScale;
+    // Release the back buffer before show() so the next frame renders during output
+    framePending.store(false, std::memory_order_release);
+    show();
+    if (framesShown++ == 0) {
+        firstFrameUs.store(micros(), std::memory_order_release);
     }
-    animationIndex = (animationIndex + (animationDirection ? 1 : -1)) % 3;
 }
 
-void LEDController::updateColorWipe() {
-    if (animationDirection) {
-        if (animationIndex < numLeds) {
-            leds[animationIndex] = currentColor;
-            animationIndex++;
+bool LEDController::startPipeline(BaseType_t renderCore, BaseType_t outputCore) {
+    if (pipelineRunning) return true;
+    if (!leds || stripCount == 0) {
+        Serial.println("LED pipeline needs initialize() first");
+        return false;
+    }
+    
+    pipelineRunning = true;
+    if (xTaskCreatePinnedToCore(outputTask, "led_output", 4096, this, 3,
+                                &outputTaskHandle, outputCore) != pdPASS) {
+        pipelineRunning = false;
+        Serial.println("Failed to start LED output task");
+        return false;
+    }
+    if (xTaskCreatePinnedToCore(renderTask, "led_render", 4096, this, 2,
+                                &renderTaskHandle, renderCore) != pdPASS) {
+        vTaskDelete(outputTaskHandle);
+        outputTaskHandle = nullptr;
+        pipelineRunning = false;
+        Serial.println("Failed to start LED render task");
+        return false;
+    }
+    
+    Serial.println("LED pipeline started (render core " + String(renderCore) +
+                   ", output core " + String(outputCore) + ")");
+    return true;
+}
+
+void LEDController::renderTask(void* param) {
+    LEDController* self = static_cast<LEDController*>(param);
+    for (;;) {
+        // Sleep to the next frame deadline; the last sub-tick part is spun off
+        uint32_t waitUs = self->scheduler.timeUntilNextFrame(micros());
+        if (waitUs >= 1000) {
+            vTaskDelay(pdMS_TO_TICKS(waitUs / 1000));
+            continue;
+        }
+        if (waitUs > 0) {
+            delayMicroseconds(waitUs);
         }
-    } else {
-        if (animationIndex > 0) {
-            animationIndex--;
-            leds[animationIndex] = CRGB::Black;
+        
+        // Only touch the back buffer once the output task has taken the last
+        // frame; if it hasn't, this deadline slips and shows up as jitter/drops
+        if (self->framePending.load(std::memory_order_acquire)) {
+            vTaskDelay(1);
+            continue;
+        }
+        
+        uint32_t dtUs = self->scheduler.beginFrame(micros());
+        if (self->renderFrame(dtUs)) {
+            self->publishFrame();
+            xTaskNotifyGive(self->outputTaskHandle);
         }
     }
 }
 
-void LEDController::clear() {
-    for (int i = 0; i < numLeds; i++) {
-        leds[i] = CRGB::Black;
+void LEDController::outputTask(void* param) {
+    LEDController* self = static_cast<LEDController*>(param);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        if (self->framePending.load(std::memory_order_acquire)) {
+            self->presentFrame();
+        }
     }
 }
 
+void LEDController::clear() {
+    fill_solid(leds, numLeds, CRGB::Black);
+}
+
 void LEDController::show() {
-    FastLED.show();
+    // Power limiting rides on FastLED's brightness, applied while clocking out
+    PROFILE_SCOPE(ProfileStage::SHOW);
+    FastLED.show(frontPowerScale);
 }
 
 bool LEDController::processThemeCommand(const String& jsonCommand) {
     JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, jsonCommand);
+    DeserializationError error;
+    {
+        PROFILE_SCOPE(ProfileStage::JSON_PARSE);
+        error = deserializeJson(doc, jsonCommand);
+    }
     
     if (error) {
         Serial.println("Failed to parse theme command");
@@ -167,38 +541,283 @@ bool LEDController::processThemeCommand(const String& jsonCommand) {
         setSpeed(doc["speed"]);
     }
     
-    String mode = doc["mode"];
-    if (mode == "solid") {
-        setSolidColor(doc["r"] | 255, doc["g"] | 255, doc["b"] | 255);
-    } else if (mode == "rainbow") {
-        setAnimation(AnimationType::RAINBOW);
-    } else if (mode == "breathe") {
-        if (doc.containsKey("r")) {
-            setSolidColor(doc["r"], doc["g"], doc["b"]);
+    if (doc.containsKey("fps")) {
+        setTargetFps(doc["fps"]);
+    }
+    
+    if (!loadTransition(doc)) {
+        return false;
+    }
+    
+    const char* mode = doc["mode"];
+    if (mode && strcmp(mode, "scene") == 0) {
+        return loadScene(doc["keyframes"], doc["loop"] | true);
+    }
+    if (mode && strcmp(mode, "layers") == 0) {
+        return loadLayers(doc["layers"]);
+    }
+    
+    const EffectInfo* effect;
+    if (!findThemeEffect(mode, effect)) {
+        Serial.println("Unknown theme mode: " + String(mode));
+        return false;
+    }
+    if (!effect) return true;
+    
+    // Any direct theme change takes over from a running scene
+    stopScene();
+    
+    // The effect's schema decides which of the remaining keys apply
+    ControlChange change;
+    change.flags = CONTROL_EFFECT | CONTROL_TRANSITION;
+    change.animation = effect->type;
+    if (effect->params & EFFECT_PARAM_COLOR_DEFAULT) {
+        change.flags |= CONTROL_COLOR;
+        change.color = CRGB(doc["r"] | 255, doc["g"] | 255, doc["b"] | 255);
+    } else if ((effect->params & EFFECT_PARAM_COLOR) && doc.containsKey("r")) {
+        change.flags |= CONTROL_COLOR;
+        change.color = CRGB(doc["r"], doc["g"], doc["b"]);
+    }
+    if ((effect->params & EFFECT_PARAM_DIRECTION) && doc.containsKey("direction")) {
+        change.flags |= CONTROL_DIRECTION;
+        change.direction = doc["direction"];
+    }
+    postControl(change);
+    Serial.println("Animation set to: " + String(effect->name));
+    
+    return true;
+}
+
+// Called from the BLE stack for every stream packet: no JSON, no allocation
+bool LEDController::writeStreamPacket(const uint8_t* data, size_t length) {
+    if (!streamRx) return false;
+    PixelStreamHeader header;
+    if (!parsePixelStreamHeader(data, length, header)) {
+        streamErrors++;
+        return false;
+    }
+    uint32_t limit = header.format == PixelStreamFormat::PALETTE ? PIXEL_STREAM_PALETTE_SIZE : numLeds;
+    if ((uint32_t)header.offset + header.count > limit) {
+        streamErrors++;
+        return false;
+    }
+    
+    // The first packet hands the pixels over to the stream
+    portENTER_CRITICAL(&controlLock);
+    bool selected = streamSelected;
+    portEXIT_CRITICAL(&controlLock);
+    if (!selected) {
+        stopScene();
+        setAnimation(AnimationType::STREAM);
+    }
+    
+    // streamRx and the palette belong to this task, so decoding needs no lock
+    bool decoded = applyPixelStreamPacket(header, data + PIXEL_STREAM_HEADER_SIZE,
+                                          length - PIXEL_STREAM_HEADER_SIZE, streamRx, streamPalette);
+    if (header.endOfFrame && decoded) {
+        portENTER_CRITICAL(&streamLock);
+        CRGB* complete = streamRx;
+        streamRx = streamFrame;
+        streamFrame = complete;
+        streamFrameReady = true;
+        portEXIT_CRITICAL(&streamLock);
+        // Packets only carry what changed, so keep assembling on top of the
+        // frame just published. The render task may be reading it too, but
+        // nobody writes it until it comes back round as streamRx.
+        memcpy(streamRx, complete, numLeds * sizeof(CRGB));
+    }
+    
+    // A bad coded packet may have been applied in part; later deltas will
+    // drift until the sender's next full frame
+    if (!decoded) {
+        streamErrors++;
+        return false;
+    }
+    streamPackets++;
+    if (header.endOfFrame) {
+        streamFrames++;
+        streamWindowFrames++;
+        uint32_t now = millis();
+        if (now - streamWindowStart >= 1000) {
+            streamFps = streamWindowFrames;
+            streamWindowFrames = 0;
+            streamWindowStart = now;
         }
-        setAnimation(AnimationType::BREATHE);
-    } else if (mode == "theater_chase") {
-        if (doc.containsKey("r")) {
-            setSolidColor(doc["r"], doc["g"], doc["b"]);
+    }
+    return true;
+}
+
+// Copy the latest complete stream frame into the render buffer
+bool LEDController::takeStreamFrame(bool force) {
+    portENTER_CRITICAL(&streamLock);
+    bool fresh = streamFrameReady;
+    if (fresh) {
+        CRGB* latest = streamFrame;
+        streamFrame = streamTaken;
+        streamTaken = latest;
+        streamFrameReady = false;
+    }
+    portEXIT_CRITICAL(&streamLock);
+    
+    if (!fresh && !force) return false;
+    memcpy(leds, streamTaken, numLeds * sizeof(CRGB));
+    return true;
+}
+
+// Optional "transition" ("fade", "wipe" or "none") and "transition_ms" keys;
+// they stay in effect for later changes
+bool LEDController::loadTransition(JsonDocument& doc) {
+    if (!doc.containsKey("transition") && !doc.containsKey("transition_ms")) return true;
+    
+    TransitionStyle style = transition.getStyle();
+    if (doc.containsKey("transition")) {
+        String name = doc["transition"];
+        if (name == "fade") {
+            style = TransitionStyle::CROSSFADE;
+        } else if (name == "wipe") {
+            style = TransitionStyle::WIPE;
+        } else if (name == "none") {
+            style = TransitionStyle::NONE;
+        } else {
+            Serial.println("Unknown transition: " + name);
+            return false;
         }
-        setAnimation(AnimationType::THEATER_CHASE);
-    } else if (mode == "color_wipe") {
-        if (doc.containsKey("r")) {
-            setSolidColor(doc["r"], doc["g"], doc["b"]);
+    }
+    transition.configure(style, doc["transition_ms"] | transition.getDurationMs());
+    return true;
+}
+
+// Scenes and layers take any effect that draws its own pixels
+bool LEDController::animationFromName(const char* name, AnimationType& type) {
+    const EffectInfo* effect = findEffect(name);
+    if (!effect || (effect->params & EFFECT_EXTERNAL)) return false;
+    type = effect->type;
+    return true;
+}
+
+// Keyframe fields: mode, r, g, b, brightness, speed, duration (ms), easing
+bool LEDController::loadScene(JsonArrayConst frames, bool loop) {
+    if (frames.size() == 0 || frames.size() > MAX_SCENE_KEYFRAMES) {
+        Serial.println("Scene needs 1-" + String(MAX_SCENE_KEYFRAMES) + " keyframes");
+        return false;
+    }
+    
+    SceneKeyframe keyframes[MAX_SCENE_KEYFRAMES];
+    int count = 0;
+    for (JsonVariantConst frame : frames) {
+        SceneKeyframe& keyframe = keyframes[count++];
+        const char* mode = frame["mode"] | "solid";
+        if (!animationFromName(mode, keyframe.effect)) {
+            Serial.println("Unknown scene mode: " + String(mode));
+            return false;
+        }
+        keyframe.color = CRGB(frame["r"] | 255, frame["g"] | 255, frame["b"] | 255);
+        keyframe.brightness = frame["brightness"] | brightness;
+        keyframe.speed = frame["speed"] | animationSpeed;
+        keyframe.durationMs = frame["duration"] | 1000;
+        
+        String easing = frame["easing"] | "linear";
+        if (easing == "ease") {
+            keyframe.easing = SceneEasing::EASE_IN_OUT;
+        } else if (easing == "step") {
+            keyframe.easing = SceneEasing::STEP;
+        } else {
+            keyframe.easing = SceneEasing::LINEAR;
         }
-        setAnimation(AnimationType::COLOR_WIPE);
     }
     
+    if (!scene.load(keyframes, count, loop)) {
+        return false;
+    }
+    scene.start(millis());
+    // The scene takes over the effect; the next stream packet claims it back
+    portENTER_CRITICAL(&controlLock);
+    streamSelected = false;
+    portEXIT_CRITICAL(&controlLock);
+    return true;
+}
+
+// Layer fields: start, length, mode, r, g, b, opacity, blend, direction.
+// An empty array removes all layers.
+bool LEDController::loadLayers(JsonArrayConst layers) {
+    if (layers.size() > MAX_LAYERS) {
+        Serial.println("Too many layers, max " + String(MAX_LAYERS));
+        return false;
+    }
+    
+    LayerConfig configs[MAX_LAYERS];
+    int count = 0;
+    for (JsonVariantConst layer : layers) {
+        LayerConfig& config = configs[count++];
+        const char* mode = layer["mode"] | "solid";
+        if (!animationFromName(mode, config.effect)) {
+            Serial.println("Unknown layer mode: " + String(mode));
+            return false;
+        }
+        config.start = layer["start"] | 0;
+        config.length = layer["length"] | numLeds;
+        config.color = CRGB(layer["r"] | 255, layer["g"] | 255, layer["b"] | 255);
+        config.opacity = layer["opacity"] | 255;
+        config.direction = layer["direction"] | true;
+        
+        String blendName = layer["blend"] | "normal";
+        if (blendName == "add") {
+            config.blendMode = BlendMode::ADD;
+        } else if (blendName == "multiply") {
+            config.blendMode = BlendMode::MULTIPLY;
+        } else if (blendName == "max") {
+            config.blendMode = BlendMode::MAX;
+        } else {
+            config.blendMode = BlendMode::NORMAL;
+        }
+    }
+    
+    if (!compositor.setLayers(configs, count)) {
+        return false;
+    }
+    ControlChange change;
+    change.flags = CONTROL_REDRAW;
+    postControl(change);
     return true;
 }
 
 String LEDController::getCurrentStatus() {
     JsonDocument doc;
-    doc["led_type"] = ledType;
+    doc["led_type"] = strips[0].config.ledType;
     doc["num_leds"] = numLeds;
+    JsonArray stripArray = doc["strips"].to<JsonArray>();
+    for (int i = 0; i < stripCount; i++) {
+        JsonObject strip = stripArray.add<JsonObject>();
+        strip["led_type"] = strips[i].config.ledType;
+        strip["num_leds"] = strips[i].config.numLeds;
+        strip["pin"] = strips[i].config.pin;
+        strip["device_type"] = strips[i].config.deviceType;
+        if (strips[i].xyTable) {
+            strip["width"] = strips[i].width;
+            strip["height"] = strips[i].height;
+        }
+        strip["active"] = strips[i].output != nullptr;
+        strip["power_ma"] = strips[i].drawMa;
+        strip["power_budget_ma"] = strips[i].config.powerBudgetMa;
+    }
     doc["brightness"] = brightness;
     doc["animation"] = (int)currentAnimation;
+    doc["animation_name"] = effectInfo(currentAnimation).name;
+    doc["transition_active"] = transition.isActive();
     doc["speed"] = animationSpeed;
+    doc["frames_shown"] = framesShown;
+    doc["frames_skipped"] = framesSkipped;
+    doc["scene_playing"] = scene.isPlaying();
+    doc["layers"] = compositor.getLayerCount();
+    doc["power_ma"] = totalDrawMa;
+    doc["power_scale"] = frontPowerScale;
+    JsonObject stream = doc["stream"].to<JsonObject>();
+    stream["packets"] = streamPackets;
+    stream["frames"] = streamFrames;
+    stream["errors"] = streamErrors;
+    stream["fps"] = streamFps;
+    scheduler.writeStats(doc["frame_timing"].to<JsonObject>());
+    bufferPool.writeReport(doc["frame_pool"].to<JsonObject>());
     
     String output;
     serializeJson(doc, output);
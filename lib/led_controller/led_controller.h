@@ -3,50 +3,192 @@
 #include <Arduino.h>
 #include <FastLED.h>
 #include <ArduinoJson.h>
+#include <atomic>
+#include "animation_type.h"
+#include "scene_engine.h"
+#include "effects.h"
+#include "effect_registry.h"
+#include "compositor.h"
+#include "transition.h"
+#include "color_pipeline.h"
+#include "frame_scheduler.h"
+#include "frame_allocator.h"
+#include "topology.h"
+#include "pixel_stream.h"
+#include "frame_codec.h"
 
-enum class AnimationType {
-    SOLID,
-    RAINBOW,
-    BREATHE,
-    THEATER_CHASE,
-    COLOR_WIPE
+// Current model for the power limiter: mA per fully lit color channel, plus
+// the quiescent draw of each pixel's driver IC
+#define LED_MA_PER_CHANNEL 20
+#define LED_IDLE_MA 1
+
+// One physical strip, taken from an entry of the "devices" config array
+struct LEDStripConfig {
+    String ledType;
+    int numLeds;
+    int pin;
+    int powerBudgetMa = 0;  // 0 = no limit
+    String deviceType = "strip";    // strip, bar, ring, matrix or custom
+    int matrixWidth = 0;
+    bool serpentine = true;
+    const uint8_t* coords = nullptr;    // custom: numLeds (x, y) pairs, only read by initialize()
 };
 
 class LEDController {
 private:
-    CRGB* leds;
-    int numLeds;
-    int ledPin;
-    String ledType;
+    FrameAllocator bufferPool;
+    
+    // Each strip drives its own slice of the shared buffers
+    struct LEDStrip {
+        LEDStripConfig config;
+        int offset;
+        CLEDController* output;
+        const ColorLut* colorLut;
+        uint32_t drawMa;    // Estimated draw of the last published frame
+        uint16_t* xyTable;  // Matrix strips: grid position -> pixel index within the strip
+        int width;
+        int height;
+    };
+    
+
+    CRGB* leds;             // Render buffer, owned by the effects
+    CRGB* frontBuffer;      // Output buffer currently bound to the strip
+    CRGB* backBuffer;       // Output buffer holding the next published frame
+    LEDStrip strips[MAX_LED_STRIPS];
+    int stripCount;
+    uint8_t* hueMap;        // Per-pixel rainbow hue offset, built once per strip
+    uint8_t* radiusMap;     // Per-pixel distance from the strip's center
+    int numLeds;            // Total pixels across all strips
     AnimationType currentAnimation;
     CRGB currentColor;
     uint8_t brightness;
-    uint16_t animationSpeed;
+    uint16_t animationSpeed;    // ms per animation step, independent of frame rate
     bool animationDirection;
-    unsigned long lastUpdate;
-    uint16_t animationIndex;
-    
-    void updateSolid();
-    void updateRainbow();
-    void updateBreathe();
-    void updateTheaterChase();
-    void updateColorWipe();
+    FrameScheduler scheduler;
+    EffectState effectState;
+    
+    // Dirty-frame tracking: identical frames are never pushed to the strip
+    bool frameDirty;
+    uint32_t framesShown;
+    uint32_t framesSkipped;
+    std::atomic<uint32_t> firstFrameUs;     // micros() when the first frame was shown
+    bool ditherPending;     // Static frame still needs dithered refreshes
+    
+    // Power limiter: scale applied by FastLED at show time, carried with the
+    // frame it was computed for
+    uint8_t backPowerScale;
+    uint8_t frontPowerScale;
+    uint32_t totalDrawMa;
+    uint8_t computePowerScale();
+    
+    // Render/output pipeline: the render task owns backBuffer while framePending
+    // is false, the output task owns it while it is true
+    std::atomic<bool> framePending;
+    bool pipelineRunning;
+    TaskHandle_t renderTaskHandle;
+    TaskHandle_t outputTaskHandle;
+    static void renderTask(void* param);
+    static void outputTask(void* param);
+    bool renderFrame(uint32_t dtUs);
+    void publishFrame();
+    void presentFrame();
+    
+    // Control changes from other tasks (BLE callbacks, setup) are staged in
+    // pendingControl and applied by the render task at the start of its next
+    // frame, so only that task touches the effect state and frameDirty
+    enum ControlFlag : uint8_t {
+        CONTROL_EFFECT = 1 << 0,        // Switch to `animation`, resetting its state
+        CONTROL_COLOR = 1 << 1,
+        CONTROL_BRIGHTNESS = 1 << 2,
+        CONTROL_SPEED = 1 << 3,
+        CONTROL_DIRECTION = 1 << 4,
+        CONTROL_FPS = 1 << 5,
+        CONTROL_TRANSITION = 1 << 6,    // Blend from the old effect/color if they change
+        CONTROL_REDRAW = 1 << 7
+    };
+    struct ControlChange {
+        uint8_t flags = 0;
+        AnimationType animation = AnimationType::SOLID;
+        CRGB color;
+        uint8_t brightness = 0;
+        uint16_t speed = 0;
+        bool direction = true;
+        uint16_t fps = 0;
+    };
+    ControlChange pendingControl;
+    bool streamSelected;    // Last effect posted is the pixel stream
+    portMUX_TYPE controlLock;
+    void postControl(const ControlChange& change);
+    void applyControl();
+    
+    // On-device scene playback (keyframes uploaded once via a "scene" theme)
+    SceneEngine scene;
+    void applyScene();
+    bool loadScene(JsonArrayConst frames, bool loop);
+    static bool animationFromName(const char* name, AnimationType& type);
+    void resetAnimation(AnimationType type);
+    
+    // Binary pixel stream, triple-buffered. Packets are decoded into streamRx
+    // on the BLE task; end-of-frame swaps it with streamFrame, and the render
+    // task swaps streamFrame with streamTaken before copying that into leds.
+    // Only the pointer swaps happen under streamLock.
+    CRGB* streamRx;
+    CRGB* streamFrame;
+    CRGB* streamTaken;
+    CRGB* streamPalette;
+    bool streamFrameReady;
+    uint32_t streamPackets;
+    uint32_t streamFrames;
+    uint32_t streamErrors;
+    uint32_t streamWindowStart;
+    uint16_t streamWindowFrames;
+    uint16_t streamFps;
+    portMUX_TYPE streamLock;
+    bool takeStreamFrame(bool force);
+    
+    // Crossfade/wipe from the previous effect after a change
+    TransitionEngine transition;
+    bool loadTransition(JsonDocument& doc);
+    
+    // Optional layers blended over the base effect
+    Compositor compositor;
+    bool loadLayers(JsonArrayConst layers);
+    
+    bool buildTopology(LEDStrip& strip);
+    static CLEDController* addStripOutput(const LEDStripConfig& config, CRGB* data);
+    void bindOutputs(CRGB* buffer);
 
 public:
     LEDController();
     ~LEDController();
     
+    // Reserve the frame buffer arenas up front (otherwise done on first initialize())
+    bool beginBufferPool(size_t internalBytes = FRAME_POOL_AUTO_SIZE,
+                         size_t psramBytes = FRAME_POOL_PSRAM_BYTES);
     bool initialize(const String& ledType, int numLeds, int pin);
+    bool initialize(const LEDStripConfig* configs, int count);
     void setAnimation(AnimationType type);
     void setSolidColor(uint8_t r, uint8_t g, uint8_t b);
     void setBrightness(uint8_t brightness);
     void setSpeed(uint16_t speed);
     void setDirection(bool forward);
+    void setTargetFps(uint16_t fps);
+    
+    // Pixel index of grid position (x, y) on a matrix strip, or -1
+    int xyToIndex(int strip, int x, int y) const;
     void update();
     void clear();
     void show();
     
+    // Run rendering and FastLED.show() on their own tasks (call after initialize())
+    bool startPipeline(BaseType_t renderCore = 1, BaseType_t outputCore = 0);
+    bool isPipelineRunning() const { return pipelineRunning; }
+    bool usesPin(int pin) const;        // True if a strip's data line is on this GPIO
+    
     // Command processing
     bool processThemeCommand(const String& jsonCommand);
+    bool writeStreamPacket(const uint8_t* data, size_t length);
+    void stopScene();
     String getCurrentStatus();
+    uint32_t getFirstFrameUs() const { return firstFrameUs.load(std::memory_order_acquire); }  // 0 until then
 };
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// SWAR blend kernels on pixels packed as 0x00RRGGBB. R and B sit 16 bits
+// apart, so both are handled by one 32-bit multiply or compare with 8 bits
+// of headroom per lane; G takes a second pass through the same lane layout.
+
+static inline uint32_t packPixel(const CRGB& c) {
+    return ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b;
+}
+
+static inline CRGB unpackPixel(uint32_t p) {
+    return CRGB((uint8_t)(p >> 16), (uint8_t)(p >> 8), (uint8_t)p);
+}
+
+// dst + (src - dst) * alpha / 256, alpha 0-255 mapped to 0-256
+static inline uint32_t blendLerp(uint32_t dst, uint32_t src, uint8_t alpha) {
+    uint32_t a = alpha + (alpha >> 7);
+    uint32_t inv = 256 - a;
+    uint32_t rb = ((src & 0xFF00FF) * a + (dst & 0xFF00FF) * inv) >> 8;
+    uint32_t g = ((src & 0x00FF00) * a + (dst & 0x00FF00) * inv) >> 8;
+    return (rb & 0xFF00FF) | (g & 0x00FF00);
+}
+
+// blendLerp over raw channel bytes: above = below + (above - below) * alpha / 256.
+// A uniform fade treats every channel alike, so whole 32-bit words are blended
+// without packing pixels, two lanes per multiply as in blendLerp.
+static inline void blendLerpBytes(uint8_t* above, const uint8_t* below, size_t bytes, uint8_t alpha) {
+    uint32_t a = alpha + (alpha >> 7);
+    uint32_t inv = 256 - a;
+    size_t i = 0;
+    for (; i + 4 <= bytes; i += 4) {
+        uint32_t src, dst;
+        memcpy(&src, above + i, 4);
+        memcpy(&dst, below + i, 4);
+        uint32_t even = (((src & 0xFF00FF) * a + (dst & 0xFF00FF) * inv) >> 8) & 0xFF00FF;
+        uint32_t odd = (((src >> 8) & 0xFF00FF) * a + ((dst >> 8) & 0xFF00FF) * inv) & 0xFF00FF00;
+        src = even | odd;
+        memcpy(above + i, &src, 4);
+    }
+    for (; i < bytes; i++) {
+        above[i] = (above[i] * a + below[i] * inv) >> 8;
+    }
+}
+
+// Per-byte saturating add
+static inline uint32_t blendAdd(uint32_t a, uint32_t b) {
+    uint32_t low = (a & 0x7F7F7F) + (b & 0x7F7F7F);
+    uint32_t sum = low ^ ((a ^ b) & 0x808080);
+    uint32_t overflow = ((a & b) | ((a | b) & low)) & 0x808080;
+    return sum | ((overflow >> 7) * 0xFF);
+}
+
+// Per-lane max of two 0x00XX00YY words
+static inline uint32_t laneMax(uint32_t a, uint32_t b) {
+    uint32_t ge = (((a | 0x1000100) - b) >> 8) & 0x10001;  // 1 where a >= b
+    uint32_t mask = ge * 0xFF;
+    return (a & mask) | (b & ~mask);
+}
+
+static inline uint32_t blendMax(uint32_t a, uint32_t b) {
+    uint32_t rb = laneMax(a & 0xFF00FF, b & 0xFF00FF);
+    uint32_t g = laneMax((a >> 8) & 0xFF00FF, (b >> 8) & 0xFF00FF);
+    return rb | ((g & 0xFF) << 8);
+}
+
+// a * b / 256 per channel. Each lane needs a different multiplier, so R/B
+// are scaled in one word and G in another, then merged.
+static inline uint32_t blendMultiply(uint32_t a, uint32_t b) {
+    uint32_t rb = (((a & 0xFF0000) >> 8) * (((b >> 16) & 0xFF) + 1)) & 0xFF0000;
+    rb |= ((a & 0xFF) * ((b & 0xFF) + 1)) >> 8;
+    uint32_t g = (((a >> 8) & 0xFF) * (((b >> 8) & 0xFF) + 1)) & 0xFF00;
+    return rb | g;
+}
@@ -0,0 +1,32 @@
+#include "pixel_stream.h"
+#include "frame_codec.h"
+
+bool applyPixelStreamPacket(const PixelStreamHeader& header, const uint8_t* payload, size_t length,
+                            CRGB* pixels, CRGB* palette) {
+    switch (header.format) {
+        case PixelStreamFormat::RGB:
+            // CRGB is three packed bytes in r, g, b order, same as the wire
+            memcpy(pixels + header.offset, payload, header.count * sizeof(CRGB));
+            return true;
+        case PixelStreamFormat::INDEXED: {
+            CRGB* dst = pixels + header.offset;
+            for (int i = 0; i < header.count; i++) {
+                dst[i] = palette[payload[i]];
+            }
+            return true;
+        }
+        case PixelStreamFormat::PALETTE:
+            memcpy(palette + header.offset, payload, header.count * sizeof(CRGB));
+            return true;
+        case PixelStreamFormat::RLE:
+            return decodeFrame(FrameCodecMode::RLE, payload, length,
+                               pixels + header.offset, header.count, nullptr);
+        case PixelStreamFormat::DELTA_RLE:
+            return decodeFrame(FrameCodecMode::DELTA_RLE, payload, length,
+                               pixels + header.offset, header.count, nullptr);
+        case PixelStreamFormat::INDEXED_RLE:
+            return decodeFrame(FrameCodecMode::INDEXED_RLE, payload, length,
+                               pixels + header.offset, header.count, palette);
+    }
+    return false;
+}
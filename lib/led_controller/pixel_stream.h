@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// Binary pixel stream, written to the PIXEL_STREAM_RX characteristic.
+// Every packet is self-contained so a frame can be split across as many
+// MTU-sized writes as needed:
+//
+//   byte 0     flags: low nibble = PixelStreamFormat, PIXEL_STREAM_END_OF_FRAME
+//   bytes 1-2  offset, little-endian (first pixel, or first palette entry)
+//   bytes 3-4  count, little-endian (pixels, or palette entries)
+//   payload    RGB:     count * 3 bytes (r, g, b)
+//              INDEXED: count bytes, one palette index per pixel
+//              PALETTE: count * 3 bytes, palette entries starting at offset
+//              RLE, DELTA_RLE, INDEXED_RLE: frame_codec ops covering count pixels
+//
+// Pixels stay invisible until a packet carrying PIXEL_STREAM_END_OF_FRAME
+// arrives (a header with count 0 just latches the frame).
+
+#define PIXEL_STREAM_HEADER_SIZE 5
+#define PIXEL_STREAM_END_OF_FRAME 0x80
+#define PIXEL_STREAM_PALETTE_SIZE 256
+
+enum class PixelStreamFormat : uint8_t {
+    RGB = 0,
+    INDEXED = 1,
+    PALETTE = 2,
+    RLE = 3,
+    DELTA_RLE = 4,     // XOR against the pixels already received
+    INDEXED_RLE = 5
+};
+
+struct PixelStreamHeader {
+    PixelStreamFormat format;
+    bool endOfFrame;
+    uint16_t offset;
+    uint16_t count;
+};
+
+// Parse and validate a packet header; payload starts at PIXEL_STREAM_HEADER_SIZE
+inline bool parsePixelStreamHeader(const uint8_t* data, size_t length, PixelStreamHeader& header) {
+    if (length < PIXEL_STREAM_HEADER_SIZE) return false;
+    uint8_t format = data[0] & 0x0F;
+    if (format > (uint8_t)PixelStreamFormat::INDEXED_RLE) return false;
+    header.format = (PixelStreamFormat)format;
+    header.endOfFrame = (data[0] & PIXEL_STREAM_END_OF_FRAME) != 0;
+    header.offset = data[1] | (data[2] << 8);
+    header.count = data[3] | (data[4] << 8);
+    
+    // Coded payloads are variable length and bounds-checked by the decoder
+    if (header.format > PixelStreamFormat::PALETTE) return true;
+    size_t bytesPerItem = header.format == PixelStreamFormat::INDEXED ? 1 : 3;
+    return length - PIXEL_STREAM_HEADER_SIZE >= header.count * bytesPerItem;
+}
+
+// Apply one packet's payload to the frame being assembled (or to the palette).
+// The header must have passed parsePixelStreamHeader() and the offset/count
+// bounds check. False if a coded payload is malformed; it may be applied in part.
+bool applyPixelStreamPacket(const PixelStreamHeader& header, const uint8_t* payload, size_t length,
+                            CRGB* pixels, CRGB* palette);
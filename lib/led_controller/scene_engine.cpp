@@ -0,0 +1,112 @@
+#include "scene_engine.h"
+
+SceneEngine::SceneEngine() : keyframeCount(0), totalDuration(0), looping(false),
+    playing(false), startTime(0), currentKeyframe(0), currentKeyframeStart(0),
+    lock(portMUX_INITIALIZER_UNLOCKED) {}
+
+bool SceneEngine::load(const SceneKeyframe* frames, int count, bool loop) {
+    if (count <= 0 || count > MAX_SCENE_KEYFRAMES) {
+        Serial.println("Invalid scene keyframe count: " + String(count));
+        return false;
+    }
+    
+    uint32_t duration = 0;
+    for (int i = 0; i < count; i++) {
+        duration += frames[i].durationMs;
+    }
+    if (duration == 0) {
+        Serial.println("Scene has zero duration");
+        return false;
+    }
+    
+    portENTER_CRITICAL(&lock);
+    playing = false;
+    memcpy(keyframes, frames, count * sizeof(SceneKeyframe));
+    keyframeCount = count;
+    totalDuration = duration;
+    looping = loop;
+    portEXIT_CRITICAL(&lock);
+    
+    Serial.println("Scene loaded: " + String(count) + " keyframes, " + String(duration) + " ms");
+    return true;
+}
+
+void SceneEngine::start(unsigned long now) {
+    portENTER_CRITICAL(&lock);
+    startTime = now;
+    currentKeyframe = 0;
+    currentKeyframeStart = 0;
+    playing = keyframeCount > 0;
+    portEXIT_CRITICAL(&lock);
+}
+
+void SceneEngine::stop() {
+    portENTER_CRITICAL(&lock);
+    playing = false;
+    portEXIT_CRITICAL(&lock);
+}
+
+uint8_t SceneEngine::applyEasing(SceneEasing easing, uint8_t progress) {
+    switch (easing) {
+        case SceneEasing::EASE_IN_OUT:
+            return ease8InOutCubic(progress);
+        case SceneEasing::STEP:
+            return 0;
+        case SceneEasing::LINEAR:
+        default:
+            return progress;
+    }
+}
+
+bool SceneEngine::evaluate(unsigned long now, SceneState& state) {
+    portENTER_CRITICAL(&lock);
+    if (!playing) {
+        portEXIT_CRITICAL(&lock);
+        return false;
+    }
+    
+    // Position is always derived from the start time, so timing never drifts
+    uint32_t elapsed = now - startTime;
+    if (elapsed >= totalDuration) {
+        if (!looping) {
+            const SceneKeyframe& last = keyframes[keyframeCount - 1];
+            state.effect = last.effect;
+            state.color = last.color;
+            state.brightness = last.brightness;
+            state.speed = last.speed;
+            state.keyframe = keyframeCount - 1;
+            playing = false;
+            portEXIT_CRITICAL(&lock);
+            return false;
+        }
+        elapsed %= totalDuration;
+    }
+    
+    // Walk forward from the cached keyframe; restart from 0 after a loop wrap
+    if (elapsed < currentKeyframeStart) {
+        currentKeyframe = 0;
+        currentKeyframeStart = 0;
+    }
+    while (elapsed >= currentKeyframeStart + keyframes[currentKeyframe].durationMs) {
+        currentKeyframeStart += keyframes[currentKeyframe].durationMs;
+        currentKeyframe++;
+    }
+    
+    const SceneKeyframe& from = keyframes[currentKeyframe];
+    int nextIndex = currentKeyframe + 1;
+    if (nextIndex == keyframeCount) {
+        nextIndex = looping ? 0 : currentKeyframe;
+    }
+    const SceneKeyframe& to = keyframes[nextIndex];
+    
+    uint8_t progress = ((elapsed - currentKeyframeStart) * 256UL) / from.durationMs;
+    uint8_t amount = applyEasing(from.easing, progress);
+    
+    state.effect = from.effect;
+    state.color = blend(from.color, to.color, amount);
+    state.brightness = lerp8by8(from.brightness, to.brightness, amount);
+    state.speed = from.speed + (((int32_t)to.speed - from.speed) * amount) / 256;
+    state.keyframe = currentKeyframe;
+    portEXIT_CRITICAL(&lock);
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "animation_type.h"
+
+#define MAX_SCENE_KEYFRAMES 32
+
+enum class SceneEasing {
+    LINEAR,
+    EASE_IN_OUT,
+    STEP
+};
+
+// One step of a scene. Color, brightness and speed ease from this keyframe
+// towards the next one over durationMs; the effect switches at the boundary.
+struct SceneKeyframe {
+    AnimationType effect;
+    CRGB color;
+    uint8_t brightness;
+    uint16_t speed;
+    uint32_t durationMs;
+    SceneEasing easing;
+};
+
+// Parameters the LED controller should render with at a given instant
+struct SceneState {
+    AnimationType effect;
+    CRGB color;
+    uint8_t brightness;
+    uint16_t speed;
+    int keyframe;
+};
+
+class SceneEngine {
+private:
+    SceneKeyframe keyframes[MAX_SCENE_KEYFRAMES];
+    int keyframeCount;
+    uint32_t totalDuration;
+    bool looping;
+    bool playing;
+    unsigned long startTime;
+    int currentKeyframe;
+    uint32_t currentKeyframeStart;
+    portMUX_TYPE lock;
+    
+    static uint8_t applyEasing(SceneEasing easing, uint8_t progress);
+
+public:
+    SceneEngine();
+    
+    bool load(const SceneKeyframe* frames, int count, bool loop);
+    void start(unsigned long now);
+    void stop();
+    bool isPlaying() const { return playing; }
+    int getKeyframeCount() const { return keyframeCount; }
+    
+    // Evaluate the timeline at `now`; returns false once a non-looping scene has ended
+    bool evaluate(unsigned long now, SceneState& state);
+};
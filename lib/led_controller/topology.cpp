@@ -0,0 +1,96 @@
+#include "topology.h"
+#include <math.h>
+
+TopologyType topologyFromDeviceType(const String& deviceType) {
+    if (deviceType == "ring") return TopologyType::RING;
+    if (deviceType == "matrix") return TopologyType::MATRIX;
+    if (deviceType == "custom") return TopologyType::CUSTOM;
+    return TopologyType::STRIP;
+}
+
+// Float math is fine here: this runs once per strip at initialize()
+static uint8_t radiusFromCenter(float dx, float dy, float maxRadius) {
+    if (maxRadius <= 0) return 0;
+    float radius = sqrtf(dx * dx + dy * dy) * 255.0f / maxRadius;
+    return radius > 255.0f ? 255 : (uint8_t)radius;
+}
+
+// One hue cycle over `count` pixels using an 8.8 fixed-point step
+static void spreadHue(uint8_t* map, int count, uint32_t span) {
+    uint16_t hueStep = (uint16_t)((span << 8) / count);
+    uint16_t hue = 0;
+    for (int i = 0; i < count; i++) {
+        map[i] = hue >> 8;
+        hue += hueStep;
+    }
+}
+
+static void buildStrip(const TopologyConfig& config, const TopologyMaps& maps) {
+    spreadHue(maps.hueMap, config.count, 255);
+    float center = (config.count - 1) / 2.0f;
+    for (int i = 0; i < config.count; i++) {
+        maps.radiusMap[i] = radiusFromCenter(i - center, 0, center);
+    }
+}
+
+static void buildRing(const TopologyConfig& config, const TopologyMaps& maps) {
+    // Hue follows the angle so the rainbow closes seamlessly; every pixel sits on the rim
+    spreadHue(maps.hueMap, config.count, 256);
+    memset(maps.radiusMap, 255, config.count);
+}
+
+static void buildMatrix(const TopologyConfig& config, const TopologyMaps& maps) {
+    int width = config.width > 0 ? config.width : config.count;
+    int height = (config.count + width - 1) / width;
+    float centerX = (width - 1) / 2.0f;
+    float centerY = (height - 1) / 2.0f;
+    float maxRadius = sqrtf(centerX * centerX + centerY * centerY);
+    int span = (width - 1) + (height - 1);
+    
+    for (int i = 0; i < config.count; i++) {
+        int y = i / width;
+        int x = i % width;
+        if (config.serpentine && (y & 1)) {
+            x = width - 1 - x;
+        }
+        maps.hueMap[i] = span > 0 ? ((x + y) * 255L) / span : 0;
+        maps.radiusMap[i] = radiusFromCenter(x - centerX, y - centerY, maxRadius);
+        if (maps.xyTable) {
+            maps.xyTable[y * width + x] = i;
+        }
+    }
+}
+
+static void buildCustom(const TopologyConfig& config, const TopologyMaps& maps) {
+    const float maxRadius = 128.0f * 1.41421356f;
+    for (int i = 0; i < config.count; i++) {
+        float dx = config.coords[i * 2] - 127.5f;
+        float dy = config.coords[i * 2 + 1] - 127.5f;
+        float angle = atan2f(dy, dx);  // -pi..pi
+        maps.hueMap[i] = (uint8_t)((angle + (float)M_PI) * 255.0f / (2.0f * (float)M_PI));
+        maps.radiusMap[i] = radiusFromCenter(dx, dy, maxRadius);
+    }
+}
+
+void buildTopologyMaps(const TopologyConfig& config, const TopologyMaps& maps) {
+    if (config.count <= 0) return;
+    switch (config.type) {
+        case TopologyType::RING:
+            buildRing(config, maps);
+            break;
+        case TopologyType::MATRIX:
+            buildMatrix(config, maps);
+            break;
+        case TopologyType::CUSTOM:
+            if (config.coords) {
+                buildCustom(config, maps);
+                break;
+            }
+            buildStrip(config, maps);
+            break;
+        case TopologyType::STRIP:
+        default:
+            buildStrip(config, maps);
+            break;
+    }
+}
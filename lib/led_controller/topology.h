@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Physical layout of one strip, from the device's "device_type"
+enum class TopologyType {
+    STRIP,      // strip / bar: a line
+    RING,
+    MATRIX,     // rows of matrixWidth pixels, progressive or serpentine
+    CUSTOM      // explicit (x, y) per pixel
+};
+
+TopologyType topologyFromDeviceType(const String& deviceType);
+
+// Per-pixel lookup tables for one strip, built once at initialize() so 2D and
+// radial effects never compute coordinates in the render loop
+struct TopologyMaps {
+    uint8_t* hueMap;        // Rainbow phase: along the strip, around the ring, diagonal on a matrix
+    uint8_t* radiusMap;     // Distance from the layout's center, 0-255
+    uint16_t* xyTable;      // Matrix only: (y * width + x) -> pixel index
+};
+
+struct TopologyConfig {
+    TopologyType type;
+    int count;
+    int width;              // Matrix width in pixels
+    bool serpentine;        // Matrix rows alternate direction
+    const uint8_t* coords;  // Custom: count (x, y) pairs, 0-255
+};
+
+void buildTopologyMaps(const TopologyConfig& config, const TopologyMaps& maps);
@@ -0,0 +1,96 @@
+#include "transition.h"
+#include "pixel_blend.h"
+#include "effect_registry.h"
+
+TransitionEngine::TransitionEngine() : buffer(nullptr), numLeds(0), style(TransitionStyle::CROSSFADE),
+    durationUs(DEFAULT_TRANSITION_MS * 1000UL), active(false), fromEffect(AnimationType::SOLID),
+    fromColor(CRGB::Black), elapsedUs(0), generation(0), lock(portMUX_INITIALIZER_UNLOCKED) {
+    resetEffectState(fromState);
+}
+
+bool TransitionEngine::begin(int numLeds, FrameAllocator& pool) {
+    buffer = pool.allocateArray<CRGB>("transition", numLeds);
+    this->numLeds = numLeds;
+    active = false;
+    return buffer != nullptr;
+}
+
+void TransitionEngine::configure(TransitionStyle newStyle, uint16_t durationMs) {
+    portENTER_CRITICAL(&lock);
+    style = newStyle;
+    durationUs = durationMs * 1000UL;
+    portEXIT_CRITICAL(&lock);
+}
+
+void TransitionEngine::start(AnimationType effect, CRGB color, const EffectState& state) {
+    if (!buffer || style == TransitionStyle::NONE || durationUs == 0) return;
+    // Streamed pixels can't be re-rendered, so there is nothing to fade from
+    if (effectInfo(effect).params & EFFECT_EXTERNAL) return;
+    
+    portENTER_CRITICAL(&lock);
+    fromEffect = effect;
+    fromColor = color;
+    fromState = state;
+    elapsedUs = 0;
+    active = true;
+    generation++;
+    portEXIT_CRITICAL(&lock);
+}
+
+void TransitionEngine::cancel() {
+    portENTER_CRITICAL(&lock);
+    active = false;
+    generation++;
+    portEXIT_CRITICAL(&lock);
+}
+
+bool TransitionEngine::render(CRGB* leds, const EffectContext& ctx) {
+    portENTER_CRITICAL(&lock);
+    if (!active) {
+        portEXIT_CRITICAL(&lock);
+        return false;
+    }
+    AnimationType effect = fromEffect;
+    CRGB color = fromColor;
+    EffectState state = fromState;
+    TransitionStyle currentStyle = style;
+    uint32_t duration = durationUs;
+    uint32_t elapsed = elapsedUs + ctx.dtUs;
+    uint32_t renderedGeneration = generation;
+    bool done = elapsed >= duration;
+    if (done) {
+        active = false;
+    } else {
+        elapsedUs = elapsed;
+    }
+    portEXIT_CRITICAL(&lock);
+    
+    // The final frame is the new effect alone, already in leds
+    if (done) return true;
+    
+    // The buffer is only ever written here, but a forced redraw keeps
+    // incremental effects correct across back-to-back transitions
+    EffectContext outgoing = ctx;
+    outgoing.leds = buffer;
+    outgoing.color = color;
+    outgoing.force = true;
+    renderEffect(effect, outgoing, state);
+    
+    // One divide per frame, then 8-bit kernels per channel
+    uint8_t progress = (uint64_t)elapsed * 255 / duration;
+    int count = ctx.count < numLeds ? ctx.count : numLeds;
+    if (currentStyle == TransitionStyle::WIPE) {
+        int edge = (count * (uint32_t)progress) >> 8;
+        memcpy(leds + edge, buffer + edge, (count - edge) * sizeof(CRGB));
+    } else {
+        // CRGB is packed r, g, b, so the frames blend as flat channel arrays
+        blendLerpBytes((uint8_t*)leds, (const uint8_t*)buffer, count * sizeof(CRGB), progress);
+    }
+    
+    portENTER_CRITICAL(&lock);
+    if (generation == renderedGeneration) {
+        fromState = state;
+    }
+    portEXIT_CRITICAL(&lock);
+    return true;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "animation_type.h"
+#include "effects.h"
+#include "frame_allocator.h"
+
+#define DEFAULT_TRANSITION_MS 400
+
+enum class TransitionStyle {
+    NONE,
+    CROSSFADE,
+    WIPE
+};
+
+// Blends from the outgoing effect to the new one after an effect or color
+// change. The outgoing effect keeps animating in its own buffer, so a
+// transition frame costs at most two effect renders plus one blend pass.
+class TransitionEngine {
+private:
+    CRGB* buffer;               // Outgoing effect's frame
+    int numLeds;
+    TransitionStyle style;
+    uint32_t durationUs;
+    bool active;
+    AnimationType fromEffect;
+    CRGB fromColor;
+    EffectState fromState;
+    uint32_t elapsedUs;
+    uint32_t generation;        // Bumped by start()/cancel() so render() drops stale state
+    portMUX_TYPE lock;
+
+public:
+    TransitionEngine();
+    
+    bool begin(int numLeds, FrameAllocator& pool);
+    void configure(TransitionStyle style, uint16_t durationMs);
+    TransitionStyle getStyle() const { return style; }
+    uint16_t getDurationMs() const { return durationUs / 1000; }
+    
+    // Start blending away from the given effect, color and animation state
+    void start(AnimationType effect, CRGB color, const EffectState& state);
+    void cancel();
+    bool isActive() const { return active; }
+    
+    // Blend the outgoing effect into `leds`, which already holds the new
+    // frame. ctx supplies the maps, brightness, direction and timing.
+    // Returns true while a transition was applied this frame.
+    bool render(CRGB* leds, const EffectContext& ctx);
+};
@@ -1,8 +1,24 @@
 #ifndef PIN_DEFN_H
 #define PIN_DEFN_H
 
+#include <Arduino.h>
+
 // Hardware pins
 #define LED_PIN 2
-#define SENSOR_PIN A10
+// On ADC1 so the sensor stream can use ADC DMA; ADC2 pins (A10 included)
+// have no DMA mode and fall back to polling
+#if CONFIG_IDF_TARGET_ESP32S3
+#define SENSOR_PIN 6            // ADC1_CH5
+#else
+#define SENSOR_PIN 34           // ADC1_CH6, input only
+#endif
+
+// Plain on/off indicator for the "led" and "blink" BLE commands. Kept off the
+// strip data pins: RMT drives those, and toggling one corrupts the frames
+#if CONFIG_IDF_TARGET_ESP32S3
+#define STATUS_LED_PIN 11
+#else
+#define STATUS_LED_PIN 25
+#endif
 
 #endif
@@ -0,0 +1,83 @@
+#include "profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+struct StageHistogram {
+    uint32_t buckets[PROFILE_BUCKETS];
+    uint32_t count;
+    uint32_t max;
+};
+
+static StageHistogram histograms[(int)ProfileStage::COUNT];
+static portMUX_TYPE profilerLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char* const STAGE_NAMES[(int)ProfileStage::COUNT] = {
+    "render", "show", "ble_command", "json_parse", "storage", "sensor"
+};
+
+// Octave from the leading zero count, sub-bucket from the next two bits
+static uint32_t bucketFor(uint32_t cycles) {
+    if (cycles < PROFILE_SUB_BUCKETS) return cycles;
+    uint32_t octave = 31 - __builtin_clz(cycles);
+    uint32_t sub = (cycles >> (octave - 2)) & (PROFILE_SUB_BUCKETS - 1);
+    return octave * PROFILE_SUB_BUCKETS + sub;
+}
+
+// Upper edge of a bucket, so reported percentiles never understate
+static uint32_t bucketLimit(uint32_t bucket) {
+    if (bucket < PROFILE_SUB_BUCKETS) return bucket;
+    uint32_t octave = bucket / PROFILE_SUB_BUCKETS;
+    uint32_t sub = bucket % PROFILE_SUB_BUCKETS;
+    uint64_t base = 1ULL << octave;
+    uint64_t limit = base + ((sub + 1) * base) / PROFILE_SUB_BUCKETS - 1;
+    return limit > 0xFFFFFFFFULL ? 0xFFFFFFFF : (uint32_t)limit;
+}
+
+void profilerRecord(ProfileStage stage, uint32_t cycles) {
+    StageHistogram& histogram = histograms[(int)stage];
+    uint32_t bucket = bucketFor(cycles);
+    portENTER_CRITICAL(&profilerLock);
+    histogram.buckets[bucket]++;
+    histogram.count++;
+    if (cycles > histogram.max) histogram.max = cycles;
+    portEXIT_CRITICAL(&profilerLock);
+}
+
+void profilerReset() {
+    portENTER_CRITICAL(&profilerLock);
+    memset(histograms, 0, sizeof(histograms));
+    portEXIT_CRITICAL(&profilerLock);
+}
+
+static uint32_t percentile(const StageHistogram& histogram, uint32_t perMille) {
+    uint32_t target = ((uint64_t)histogram.count * perMille + 999) / 1000;
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < PROFILE_BUCKETS; i++) {
+        seen += histogram.buckets[i];
+        if (seen >= target) {
+            uint32_t limit = bucketLimit(i);
+            return limit < histogram.max ? limit : histogram.max;
+        }
+    }
+    return histogram.max;
+}
+
+void profilerReport(JsonObject out) {
+    uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+    for (int i = 0; i < (int)ProfileStage::COUNT; i++) {
+        // Copy out so the report is consistent and the lock is held briefly
+        StageHistogram histogram;
+        portENTER_CRITICAL(&profilerLock);
+        histogram = histograms[i];
+        portEXIT_CRITICAL(&profilerLock);
+        
+        JsonObject stage = out[STAGE_NAMES[i]].to<JsonObject>();
+        stage["n"] = histogram.count;
+        if (histogram.count == 0) continue;
+        stage["p50_us"] = percentile(histogram, 500) / cyclesPerUs;
+        stage["p99_us"] = percentile(histogram, 990) / cyclesPerUs;
+        stage["max_us"] = histogram.max / cyclesPerUs;
+    }
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+// Per-stage cycle-count histograms. Everything here compiles to nothing
+// unless the build defines ENABLE_PROFILER (see the *-profile envs).
+
+enum class ProfileStage : uint8_t {
+    RENDER,
+    SHOW,
+    BLE_COMMAND,
+    JSON_PARSE,
+    STORAGE,
+    SENSOR,
+    COUNT
+};
+
+#ifdef ENABLE_PROFILER
+
+// Log2 octaves split into 4 linear sub-buckets: percentiles within ~25%
+#define PROFILE_SUB_BUCKETS 4
+#define PROFILE_BUCKETS (32 * PROFILE_SUB_BUCKETS)
+
+void profilerRecord(ProfileStage stage, uint32_t cycles);
+void profilerReset();
+void profilerReport(JsonObject out);
+
+class ProfileScope {
+private:
+    ProfileStage stage;
+    uint32_t start;
+
+public:
+    explicit ProfileScope(ProfileStage stage) : stage(stage), start(ESP.getCycleCount()) {}
+    ~ProfileScope() { profilerRecord(stage, ESP.getCycleCount() - start); }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+
+#else
+
+#define PROFILE_SCOPE(stage) do {} while (0)
+
+#endif
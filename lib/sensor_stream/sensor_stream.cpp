@@ -0,0 +1,171 @@
+#include "sensor_stream.h"
+#include <driver/adc.h>
+
+#define DMA_FRAME_BYTES 256
+#define ENVELOPE_RELEASE_SHIFT 7    // ~64 ms release at 2 kHz
+#define BAND_SMOOTH_SHIFT 6
+
+SensorStream::SensorStream() : pin(-1), channel(-1), dmaMode(false), sampleRateHz(0),
+    samplerHandle(nullptr), overruns(0), windowSum(0), windowPos(0), envelope(0),
+    fastLowpass(0), slowLowpass(0), average(0), peak(0) {
+    memset(window, 0, sizeof(window));
+    for (int i = 0; i < SENSOR_BAND_COUNT; i++) {
+        bandAccum[i] = 0;
+        bands[i].store(0);
+    }
+}
+
+bool SensorStream::begin(int sensorPin, BaseType_t core) {
+    if (samplerHandle) return true;
+    pin = sensorPin;
+    channel = digitalPinToAnalogChannel(pin);
+    if (channel < 0) {
+        Serial.println("Sensor pin " + String(pin) + " is not an ADC pin");
+        return false;
+    }
+    
+    // Channels past the first unit belong to ADC2, which has no DMA mode
+    dmaMode = channel < SOC_ADC_MAX_CHANNEL_NUM && startDma();
+    if (!dmaMode) {
+        Serial.println("Warning: sensor pin " + String(pin) +
+                       (channel < SOC_ADC_MAX_CHANNEL_NUM ? " failed to start ADC DMA" : " is on ADC2, which has no DMA") +
+                       ", polling at " + String(SENSOR_POLL_RATE_HZ) + " Hz instead");
+    }
+    sampleRateHz = dmaMode ? SENSOR_DMA_RATE_HZ / SENSOR_DMA_DECIMATION : SENSOR_POLL_RATE_HZ;
+    
+    if (xTaskCreatePinnedToCore(samplerTask, "sensor", 3072, this, 3, &samplerHandle, core) != pdPASS) {
+        Serial.println("Failed to start sensor sampler task");
+        samplerHandle = nullptr;
+        return false;
+    }
+    Serial.println("Sensor sampling on pin " + String(pin) + (dmaMode ? " (ADC DMA, " : " (polled, ") +
+                   String(sampleRateHz) + " Hz)");
+    return true;
+}
+
+bool SensorStream::startDma() {
+    adc_digi_init_config_t initConfig = {};
+    initConfig.max_store_buf_size = DMA_FRAME_BYTES * 4;
+    initConfig.conv_num_each_intr = DMA_FRAME_BYTES;
+    initConfig.adc1_chan_mask = BIT(channel);
+    initConfig.adc2_chan_mask = 0;
+    if (adc_digi_initialize(&initConfig) != ESP_OK) return false;
+    
+    adc_digi_pattern_config_t pattern = {};
+    pattern.atten = ADC_ATTEN_DB_11;
+    pattern.channel = channel;
+    pattern.unit = 0;
+    pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = true;
+    config.conv_limit_num = 250;
+    config.pattern_num = 1;
+    config.adc_pattern = &pattern;
+    config.sample_freq_hz = SENSOR_DMA_RATE_HZ;
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+#if CONFIG_IDF_TARGET_ESP32
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+#else
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+#endif
+    if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+        adc_digi_deinitialize();
+        return false;
+    }
+    return true;
+}
+
+void SensorStream::samplerTask(void* param) {
+    SensorStream* self = static_cast<SensorStream*>(param);
+    if (self->dmaMode) {
+        self->runDma();
+    } else {
+        self->runPolled();
+    }
+}
+
+void SensorStream::runDma() {
+    uint8_t frame[DMA_FRAME_BYTES];
+    uint32_t sum = 0;
+    uint8_t count = 0;
+    for (;;) {
+        uint32_t length = 0;
+        esp_err_t err = adc_digi_read_bytes(frame, sizeof(frame), &length, ADC_MAX_DELAY);
+        if (err == ESP_ERR_INVALID_STATE) {
+            // The driver's own buffer overflowed; data is still valid
+            overruns.fetch_add(1, std::memory_order_relaxed);
+        } else if (err != ESP_OK) {
+            continue;
+        }
+        
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+            const adc_digi_output_data_t* result = reinterpret_cast<const adc_digi_output_data_t*>(frame + i);
+#if CONFIG_IDF_TARGET_ESP32
+            sum += result->type1.data;
+#else
+            sum += result->type2.data;
+#endif
+            if (++count == SENSOR_DMA_DECIMATION) {
+                if (!ring.push(sum / SENSOR_DMA_DECIMATION)) {
+                    overruns.fetch_add(1, std::memory_order_relaxed);
+                }
+                sum = 0;
+                count = 0;
+            }
+        }
+    }
+}
+
+void SensorStream::runPolled() {
+    TickType_t period = pdMS_TO_TICKS(1000 / SENSOR_POLL_RATE_HZ);
+    if (period == 0) period = 1;
+    TickType_t lastWake = xTaskGetTickCount();
+    for (;;) {
+        if (!ring.push(analogRead(pin))) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        vTaskDelayUntil(&lastWake, period);
+    }
+}
+
+void SensorStream::process() {
+    uint16_t sample;
+    bool drained = false;
+    while (ring.pop(sample)) {
+        filterSample(sample);
+        drained = true;
+    }
+    if (!drained) return;
+    
+    average.store(windowSum / SENSOR_AVERAGE_WINDOW, std::memory_order_relaxed);
+    peak.store(envelope >> 8, std::memory_order_relaxed);
+    for (int i = 0; i < SENSOR_BAND_COUNT; i++) {
+        bands[i].store(bandAccum[i] >> 8, std::memory_order_relaxed);
+    }
+}
+
+// All integer: running-sum moving average, fast-attack/slow-release peak
+// envelope of the AC part, and three bands split by two one-pole lowpasses
+// (crossovers roughly 90 Hz and 440 Hz at the 2 kHz DMA rate)
+void SensorStream::filterSample(uint16_t sample) {
+    windowSum += sample - window[windowPos];
+    window[windowPos] = sample;
+    windowPos = (windowPos + 1) & (SENSOR_AVERAGE_WINDOW - 1);
+    
+    int32_t ac = ((int32_t)sample << 8) - (int32_t)((windowSum << 8) / SENSOR_AVERAGE_WINDOW);
+    uint32_t magnitude = ac < 0 ? -ac : ac;
+    if (magnitude > envelope) {
+        envelope = magnitude;
+    } else {
+        envelope -= envelope >> ENVELOPE_RELEASE_SHIFT;
+    }
+    
+    fastLowpass += ((ac - fastLowpass) * 3) >> 2;
+    slowLowpass += (ac - slowLowpass) >> 2;
+    int32_t split[SENSOR_BAND_COUNT] = { slowLowpass, fastLowpass - slowLowpass, ac - fastLowpass };
+    for (int i = 0; i < SENSOR_BAND_COUNT; i++) {
+        uint32_t level = split[i] < 0 ? -split[i] : split[i];
+        bandAccum[i] += ((int32_t)level - (int32_t)bandAccum[i]) >> BAND_SMOOTH_SHIFT;
+    }
+}
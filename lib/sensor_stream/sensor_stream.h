@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+
+// Raw ADC sampling: ADC1 pins run in DMA (continuous) mode at SENSOR_DMA_RATE_HZ
+// and are box-averaged down by SENSOR_DMA_DECIMATION. ADC2 pins (such as A10)
+// can't use DMA, so they are polled by a task at SENSOR_POLL_RATE_HZ.
+#define SENSOR_DMA_RATE_HZ 20000
+#define SENSOR_DMA_DECIMATION 10
+#define SENSOR_POLL_RATE_HZ 1000
+#define SENSOR_RING_SIZE 512        // Power of two
+#define SENSOR_AVERAGE_WINDOW 64    // Power of two
+#define SENSOR_BAND_COUNT 3
+
+// Single-producer / single-consumer ring: the sampler task pushes, process() pops
+class SampleRing {
+private:
+    uint16_t samples[SENSOR_RING_SIZE];
+    std::atomic<uint32_t> head;     // Written by the producer only
+    std::atomic<uint32_t> tail;     // Written by the consumer only
+
+public:
+    SampleRing() : head(0), tail(0) {}
+    
+    bool push(uint16_t sample) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == SENSOR_RING_SIZE) return false;
+        samples[h & (SENSOR_RING_SIZE - 1)] = sample;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+    
+    bool pop(uint16_t& sample) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire)) return false;
+        sample = samples[t & (SENSOR_RING_SIZE - 1)];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+class SensorStream {
+private:
+    int pin;
+    int channel;
+    bool dmaMode;
+    uint32_t sampleRateHz;      // Rate of the samples in the ring, after decimation
+    TaskHandle_t samplerHandle;
+    SampleRing ring;
+    std::atomic<uint32_t> overruns;     // Samples lost because process() fell behind
+    
+    // Filter state, owned by process()
+    uint16_t window[SENSOR_AVERAGE_WINDOW];
+    uint32_t windowSum;
+    uint16_t windowPos;
+    uint32_t envelope;          // 8.8 fixed point
+    int32_t fastLowpass;        // 8.8 fixed point
+    int32_t slowLowpass;
+    uint32_t bandAccum[SENSOR_BAND_COUNT];  // 8.8 fixed point
+    
+    // Filter outputs, readable from any task without locking
+    std::atomic<uint16_t> average;
+    std::atomic<uint16_t> peak;
+    std::atomic<uint16_t> bands[SENSOR_BAND_COUNT];
+    
+    static void samplerTask(void* param);
+    bool startDma();
+    void runDma();
+    void runPolled();
+    void filterSample(uint16_t sample);
+
+public:
+    SensorStream();
+    
+    bool begin(int pin, BaseType_t core = 0);
+    
+    // Drain the ring through the filters; call often from the main loop
+    void process();
+    
+    // Latest filtered values, all on the 12-bit ADC scale
+    uint16_t getAverage() const { return average.load(std::memory_order_relaxed); }
+    uint16_t getPeak() const { return peak.load(std::memory_order_relaxed); }
+    uint16_t getBand(int band) const { return bands[band].load(std::memory_order_relaxed); }
+    uint32_t getSampleRate() const { return sampleRateHz; }
+    uint32_t getOverruns() const { return overruns.load(std::memory_order_relaxed); }
+    bool isDma() const { return dmaMode; }
+};
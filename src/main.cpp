@@ -4,109 +4,174 @@
 #include "global_vars.h"
 #include "ble_comm.h"
 #include "device_config.h"
-
-// Temporary stub for LEDController since it's not implemented yet
-class LEDController {
-public:
-    bool initialize(const String& ledType, int numLeds, int pin) {
-        Serial.println("LED Controller stub - initialize: " + ledType + " (" + String(numLeds) + " LEDs) on pin " + String(pin));
-        return true;
-    }
-    void setSolidColor(uint8_t r, uint8_t g, uint8_t b) {
-        Serial.println("LED Controller stub - setSolidColor: " + String(r) + "," + String(g) + "," + String(b));
-    }
-    void update() {
-        // Stub - do nothing for now
-    }
-};
+#include "led_controller.h"
+#include "sensor_stream.h"
 
 // Global instances
 PersistentStorage storage;
 LEDController ledController;
+SensorStream sensorStream;
+
+// Setup mode is offered from loop() for this long after boot, so the LEDs and
+// BLE never wait on the serial monitor
+#define SETUP_WINDOW_MS 5000
+
+// Boot phases, timed with micros() and reported once the first frame is out
+struct BootPhase {
+    const char* name;
+    uint32_t us;
+};
+BootPhase bootPhases[8];
+int bootPhaseCount = 0;
+bool bootReported = false;
+
+void markBootPhase(const char* name) {
+    if (bootPhaseCount < (int)(sizeof(bootPhases) / sizeof(bootPhases[0]))) {
+        bootPhases[bootPhaseCount++] = {name, (uint32_t)micros()};
+    }
+}
+
+void reportBootTiming(uint32_t firstFrameUs) {
+    Serial.println("\n=== Boot timing (ms since start) ===");
+    uint32_t previous = 0;
+    for (int i = 0; i < bootPhaseCount; i++) {
+        Serial.printf("%-12s %8.1f  (+%.1f)\n", bootPhases[i].name,
+                      bootPhases[i].us / 1000.0, (bootPhases[i].us - previous) / 1000.0);
+        previous = bootPhases[i].us;
+    }
+    Serial.printf("%-12s %8.1f\n", "first frame", firstFrameUs / 1000.0);
+}
+
+// Non-blocking: picks up an 's' during the setup window without holding up loop()
+void checkSetupRequest() {
+    static bool windowOpen = true;
+    if (!windowOpen) return;
+    if (millis() > SETUP_WINDOW_MS) {
+        windowOpen = false;
+        return;
+    }
+    while (Serial.available()) {
+        char input = Serial.read();
+        if (input != 's' && input != 'S') continue;
+        windowOpen = false;
+        uint32_t mutations = storage.getStats().mutations;
+        storage.interactiveSetup();
+        // Strips and BLE were set up from the old config; restart to apply changes
+        if (storage.getStats().mutations != mutations) {
+            storage.flush();
+            Serial.println("Configuration changed, restarting...");
+            delay(100);
+            ESP.restart();
+        }
+        return;
+    }
+}
 
 void setup() {
     Serial.begin(115200);
-    while (!Serial) delay(10);
+    markBootPhase("serial");
 
     Serial.println("\n=== HMZ IoT LED Controller Starting ===");
     
-    // Initialize SPIFFS and config storage
+    // Reserve the LED frame buffer arenas before anything else uses the heap
+    ledController.beginBufferPool();
+    markBootPhase("buffer pool");
+    
+    // Open the config store; only the record table is read here. Without it
+    // the LEDs and BLE still come up on the built-in defaults, and the BLE
+    // status reports storage as not ready
     if (!storage.begin()) {
-        Serial.println("Storage initialization failed!");
-        return;
+        Serial.println("Storage initialization failed! Running on defaults, changes will not be saved");
     }
-
-    // Show SPIFFS info
-    storage.getStorageInfo();
+    markBootPhase("storage");
     
-    // Load device name from SPIFFS configuration - get first device
-    JsonDocument configDoc;
-    deserializeJson(configDoc, storage.getAllDataCompact());
-    
-    if (configDoc["devices"].size() > 0) {
-        String configDeviceName = configDoc["devices"][0]["device_name"] | "HMZ-LED-Controller";
-        deviceName = configDeviceName;
-        Serial.println("Loaded device name from SPIFFS: " + deviceName);
+    // Load device name from the configuration - get first device
+    if (storage.getDeviceCount() > 0) {
+        deviceName = storage.getDeviceName();
+        Serial.println("Loaded device name from config: " + deviceName);
     } else {
         Serial.println("No devices in config, using default name: " + deviceName);
     }
-    
-    // Interactive setup option
-    Serial.println("\nPress 's' within 5 seconds to enter setup mode...");
-    unsigned long startTime = millis();
-    bool enterSetup = false;
-    
-    while (millis() - startTime < 5000) {
-        if (Serial.available()) {
-            char input = Serial.read();
-            if (input == 's' || input == 'S') {
-                enterSetup = true;
-                break;
+
+    // Initialize LED controller with device config. The first device is this
+    // controller's own strip; further devices are extra local strips only when
+    // they name a "data_pin" (peers reported over BLE don't have one). Peers
+    // are skipped from the record table without decoding their strings
+    LEDStripConfig stripConfigs[MAX_LED_STRIPS];
+    uint8_t* coordBuffers[MAX_LED_STRIPS] = {};
+    int stripCount = 0;
+    for (int index = 0; index < storage.getDeviceCount(); index++) {
+        if (stripCount == MAX_LED_STRIPS) break;
+        if (index > 0 && storage.getDeviceDataPin(index) < 0) continue;
+        const DeviceConfig& device = storage.getDeviceConfig(index);
+        stripConfigs[stripCount].ledType = device.ledType;
+        stripConfigs[stripCount].numLeds = device.numLeds;
+        stripConfigs[stripCount].pin = device.dataPin >= 0 ? device.dataPin : LED_PIN;
+        stripConfigs[stripCount].powerBudgetMa = device.powerBudgetMa;
+        stripConfigs[stripCount].deviceType = device.type;
+        stripConfigs[stripCount].matrixWidth = device.matrixWidth;
+        stripConfigs[stripCount].serpentine = device.serpentine;
+        
+        // Custom layouts list one [x, y] pair (0-255) per LED; the controller
+        // copies them into its lookup tables during initialize()
+        JsonDocument extra;
+        if (device.type == "custom" && device.extra.length() > 0) {
+            deserializeJson(extra, device.extra);
+        }
+        JsonArray coords = extra["coords"];
+        int numLeds = stripConfigs[stripCount].numLeds;
+        if (coords.size() > 0 && (int)coords.size() == numLeds) {
+            coordBuffers[stripCount] = new uint8_t[numLeds * 2];
+            int i = 0;
+            for (JsonArray point : coords) {
+                coordBuffers[stripCount][i++] = point[0] | 0;
+                coordBuffers[stripCount][i++] = point[1] | 0;
             }
+            stripConfigs[stripCount].coords = coordBuffers[stripCount];
         }
-        delay(100);
+        stripCount++;
     }
     
-    if (enterSetup) {
-        storage.interactiveSetup();
-        // Reload device name after potential changes
-        JsonDocument updatedDoc;
-        deserializeJson(updatedDoc, storage.getAllDataCompact());
-        if (updatedDoc["devices"].size() > 0) {
-            String updatedDeviceName = updatedDoc["devices"][0]["device_name"] | "HMZ-LED-Controller";
-            deviceName = updatedDeviceName;
-            Serial.println("Updated device name: " + deviceName);
-        }
+    bool ledsReady = stripCount > 0 && ledController.initialize(stripConfigs, stripCount);
+    for (int i = 0; i < stripCount; i++) {
+        delete[] coordBuffers[i];
     }
-    
-    Serial.println("Current configuration:");
-    Serial.println(storage.getAllData());
-    Serial.println("Using BLE device name: " + deviceName);
-
-    // Initialize LED controller with device config
-    JsonDocument ledDoc;
-    deserializeJson(ledDoc, storage.getAllDataCompact());
-    if (ledDoc["devices"].size() > 0) {
-        String ledType = ledDoc["devices"][0]["led_type"] | "WS2812B";
-        int numLeds = ledDoc["devices"][0]["num_of_leds"] | 30;
-        
-        ledController.initialize(ledType, numLeds, LED_PIN);
+    if (ledsReady) {
         ledController.setSolidColor(255, 0, 0); // Start with red
     } else {
         // Default initialization
         ledController.initialize("WS2812B", 30, LED_PIN);
         ledController.setSolidColor(255, 255, 255); // Start with white
     }
+    markBootPhase("led init");
+    
+    // Render on core 1, push frames to the strip from core 0
+    ledController.startPipeline();
+    markBootPhase("pipeline");
 
-    // Initialize BLE (now uses the deviceName from SPIFFS)
+    // Continuous sensor sampling for light/audio-reactive effects
+    sensorStream.begin(SENSOR_PIN);
+    markBootPhase("sensors");
+
+    // Initialize BLE (uses the deviceName from the config)
     ble_setup();
+    markBootPhase("ble");
     
     Serial.println("Setup complete! Ready for BLE connections.");
     Serial.println("BLE Device Name: " + deviceName);
+    Serial.printf("Press 's' within %d seconds to enter setup mode...\n", SETUP_WINDOW_MS / 1000);
 }
 
 void loop() {
+    if (!bootReported && ledController.getFirstFrameUs() != 0) {
+        bootReported = true;
+        reportBootTiming(ledController.getFirstFrameUs());
+    }
+    checkSetupRequest();
     ble_loop();
-    ledController.update();
-    delay(20); // Small delay for stability
+    storage.loop();             // Flushes config changes once they settle
+    ledController.update(); // No-op once the LED pipeline tasks are running
+    // Frame timing comes from the LED scheduler; without the pipeline the loop
+    // has to come round often enough to meet its deadlines
+    delay(ledController.isPipelineRunning() ? 20 : 1);
 }
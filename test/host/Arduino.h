@@ -0,0 +1,109 @@
+#pragma once
+
+// Host stand-in for the parts of the Arduino core the render, codec and
+// storage modules use, so they build in env:native
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <chrono>
+#include <string>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+// Enough of WString for the modules and for ArduinoJson built with
+// ARDUINOJSON_ENABLE_ARDUINO_STRING: its adapters name ::StringSumHelper, and
+// its String writer assigns a null const char* then concat()s in chunks
+class String {
+    std::string value;
+public:
+    String(const char* s = "") : value(s ? s : "") {}
+    String(const std::string& s) : value(s) {}
+    explicit String(char c) : value(1, c) {}
+    String(int v) : value(std::to_string(v)) {}
+    String(unsigned v) : value(std::to_string(v)) {}
+    String(long v) : value(std::to_string(v)) {}
+    String(unsigned long v) : value(std::to_string(v)) {}
+    String(long long v) : value(std::to_string(v)) {}
+    String(unsigned long long v) : value(std::to_string(v)) {}
+    String(float v, unsigned decimals = 2) : String((double)v, decimals) {}
+    String(double v, unsigned decimals = 2) {
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "%.*f", (int)decimals, v);
+        value = buffer;
+    }
+    const char* c_str() const { return value.c_str(); }
+    size_t length() const { return value.size(); }
+    char operator[](size_t i) const { return i < value.size() ? value[i] : 0; }
+    bool reserve(unsigned size) { value.reserve(size); return true; }
+    bool concat(const char* s) { value += s; return true; }
+    bool concat(char c) { value += c; return true; }
+    void trim() {
+        size_t first = value.find_first_not_of(" \t\r\n");
+        size_t last = value.find_last_not_of(" \t\r\n");
+        value = first == std::string::npos ? "" : value.substr(first, last - first + 1);
+    }
+    long toInt() const { return atol(value.c_str()); }
+    bool equalsIgnoreCase(const String& o) const { return strcasecmp(value.c_str(), o.value.c_str()) == 0; }
+    String& operator+=(const String& o) { value += o.value; return *this; }
+    String& operator+=(const char* s) { value += s; return *this; }
+    String& operator+=(char c) { value += c; return *this; }
+    bool operator==(const String& o) const { return value == o.value; }
+    bool operator!=(const String& o) const { return value != o.value; }
+    bool operator==(const char* s) const { return value == (s ? s : ""); }
+    bool operator!=(const char* s) const { return !(*this == s); }
+};
+
+// What the Arduino core's operator+ returns
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String& s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String& a, const String& b) { String sum(a); sum += b; return sum; }
+inline StringSumHelper operator+(const String& a, const char* b) { String sum(a); sum += b; return sum; }
+inline StringSumHelper operator+(const char* a, const String& b) { String sum(a); sum += b; return sum; }
+inline StringSumHelper operator+(const String& a, char b) { String sum(a); sum += b; return sum; }
+
+// Output goes to stdout; there is never any input
+struct HostSerial {
+    void println(const String& s = "") { puts(s.c_str()); }
+    void print(const String& s) { fputs(s.c_str(), stdout); }
+    void flush() { fflush(stdout); }
+    int available() { return 0; }
+    String readStringUntil(char) { return ""; }
+};
+inline HostSerial Serial;
+
+// Tests can move the clock forward instead of sleeping through a debounce
+inline unsigned long hostClockSkewUs = 0;
+inline void hostAdvanceClock(unsigned long ms) { hostClockSkewUs += ms * 1000; }
+
+inline unsigned long micros() {
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count() + hostClockSkewUs;
+}
+inline unsigned long millis() { return micros() / 1000; }
+inline bool psramFound() { return false; }
+inline void delay(unsigned long ms) { hostAdvanceClock(ms); }
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+struct HostEsp {
+    uint32_t getHeapSize() { return 320 * 1024; }
+    uint32_t getFreeHeap() { return 200 * 1024; }
+};
+inline HostEsp ESP;
+
+// Single-threaded host build: critical sections are no-ops
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
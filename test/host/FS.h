@@ -0,0 +1,92 @@
+#pragma once
+
+// Host stand-in for the Arduino FS API: each filesystem is a directory under
+// the system temp directory, so FsBackend runs against real host files
+
+#include <Arduino.h>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+
+namespace fs {
+
+class File {
+    std::shared_ptr<FILE> handle;
+public:
+    File() {}
+    explicit File(FILE* file) { if (file) handle.reset(file, fclose); }
+    explicit operator bool() const { return handle != nullptr; }
+    size_t size() const {
+        long position = ftell(handle.get());
+        fseek(handle.get(), 0, SEEK_END);
+        long length = ftell(handle.get());
+        fseek(handle.get(), position, SEEK_SET);
+        return length;
+    }
+    bool seek(uint32_t position) { return fseek(handle.get(), position, SEEK_SET) == 0; }
+    size_t read(uint8_t* buffer, size_t length) { return fread(buffer, 1, length, handle.get()); }
+    size_t write(const uint8_t* data, size_t length) { return fwrite(data, 1, length, handle.get()); }
+    void close() { handle.reset(); }
+};
+
+class FS {
+protected:
+    std::filesystem::path base;
+    std::filesystem::path host(const String& path) const { return base / (path.c_str() + (path.c_str()[0] == '/')); }
+public:
+    explicit FS(const char* directory) : base(std::filesystem::temp_directory_path() / directory) {}
+    // create makes missing parent directories, as LittleFS does
+    File open(const String& path, const char* mode = "r", bool create = false) {
+        std::error_code error;
+        if (create && mode[0] != 'r') std::filesystem::create_directories(host(path).parent_path(), error);
+        std::string hostMode = std::string(mode) + "b";
+        return File(fopen(host(path).c_str(), hostMode.c_str()));
+    }
+    bool exists(const String& path) {
+        std::error_code error;
+        return std::filesystem::exists(host(path), error);
+    }
+    bool remove(const String& path) {
+        std::error_code error;
+        return std::filesystem::remove(host(path), error);
+    }
+    bool rename(const String& from, const String& to) {
+        std::error_code error;
+        std::filesystem::rename(host(from), host(to), error);
+        return !error;
+    }
+    bool mkdir(const String& path) {
+        std::error_code error;
+        return std::filesystem::create_directories(host(path), error) || exists(path);
+    }
+};
+
+// The mountable filesystems (SPIFFS, LittleFS)
+class HostFS : public FS {
+public:
+    explicit HostFS(const char* directory) : FS(directory) {}
+    bool begin(bool formatOnFail = false) {
+        (void)formatOnFail;
+        std::error_code error;
+        std::filesystem::create_directories(base, error);
+        return !error;
+    }
+    size_t totalBytes() { return 1441792; }
+    size_t usedBytes() {
+        size_t used = 0;
+        std::error_code error;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(base, error)) {
+            if (entry.is_regular_file()) used += entry.file_size();
+        }
+        return used;
+    }
+    bool format() {
+        std::error_code error;
+        std::filesystem::remove_all(base, error);
+        return begin();
+    }
+};
+
+}  // namespace fs
+
+using fs::File;
@@ -0,0 +1,80 @@
+#pragma once
+
+// Host stand-in for the FastLED types and 8-bit math the effects use. The
+// math follows FastLED's own integer definitions; hsv2rgb_rainbow is a plain
+// hue wheel, which only changes the colors of the rainbow table.
+
+#include <Arduino.h>
+
+typedef uint8_t fract8;
+
+static inline uint8_t scale8(uint8_t i, fract8 scale) { return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8; }
+
+// FastLED's sin8_C: piecewise-linear quarter wave, within 2% of sin()
+static inline uint8_t sin8(uint8_t theta) {
+    static const uint8_t b_m16_interleave[] = { 0, 49, 49, 41, 90, 27, 117, 10 };
+    uint8_t offset = theta;
+    if (theta & 0x40) offset = 255 - offset;
+    offset &= 0x3F;
+    
+    uint8_t secoffset = offset & 0x0F;
+    if (theta & 0x40) secoffset++;
+    
+    const uint8_t* p = b_m16_interleave + (offset >> 4) * 2;
+    uint8_t b = p[0];
+    uint8_t m16 = p[1];
+    uint8_t mx = (m16 * secoffset) >> 4;
+    
+    int8_t y = mx + b;
+    if (theta & 0x80) y = -y;
+    return y + 128;
+}
+
+struct CHSV {
+    uint8_t h, s, v;
+    CHSV(uint8_t h, uint8_t s, uint8_t v) : h(h), s(s), v(v) {}
+};
+
+struct CRGB {
+    union {
+        struct { uint8_t r, g, b; };
+        uint8_t raw[3];
+    };
+    enum HTMLColorCode : uint32_t { Black = 0x000000, White = 0xFFFFFF, Red = 0xFF0000 };
+    
+    CRGB() {}
+    CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+    CRGB(HTMLColorCode code) : r(code >> 16), g(code >> 8), b(code) {}
+    CRGB(const CHSV& hsv);
+    bool operator==(const CRGB& o) const { return r == o.r && g == o.g && b == o.b; }
+    bool operator!=(const CRGB& o) const { return !(*this == o); }
+    CRGB& nscale8(uint8_t scale) {
+        r = scale8(r, scale);
+        g = scale8(g, scale);
+        b = scale8(b, scale);
+        return *this;
+    }
+};
+
+static inline void fill_solid(CRGB* leds, int count, const CRGB& color) {
+    for (int i = 0; i < count; i++) leds[i] = color;
+}
+
+static inline void hsv2rgb_rainbow(const CHSV& hsv, CRGB& rgb) {
+    uint8_t region = hsv.h / 43;
+    uint8_t rise = (hsv.h - region * 43) * 6;
+    uint8_t fall = 255 - rise;
+    switch (region) {
+        case 0: rgb = CRGB(255, rise, 0); break;
+        case 1: rgb = CRGB(fall, 255, 0); break;
+        case 2: rgb = CRGB(0, 255, rise); break;
+        case 3: rgb = CRGB(0, fall, 255); break;
+        case 4: rgb = CRGB(rise, 0, 255); break;
+        default: rgb = CRGB(255, 0, fall); break;
+    }
+    rgb.nscale8(hsv.v);
+}
+
+inline CRGB::CRGB(const CHSV& hsv) {
+    hsv2rgb_rainbow(hsv, *this);
+}
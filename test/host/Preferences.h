@@ -0,0 +1,45 @@
+#pragma once
+
+// Host stand-in for Preferences: namespaces live in process memory, so they
+// outlast the Preferences objects that open them, as NVS outlasts a reset
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<std::string, std::vector<uint8_t>> HostNvsNamespace;
+
+inline std::map<std::string, HostNvsNamespace>& hostNvs() {
+    static std::map<std::string, HostNvsNamespace> partition;
+    return partition;
+}
+
+class Preferences {
+    HostNvsNamespace* space = nullptr;
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        (void)readOnly;
+        space = &hostNvs()[name];
+        return true;
+    }
+    void end() { space = nullptr; }
+    bool clear() { space->clear(); return true; }
+    bool isKey(const char* key) { return space->count(key) > 0; }
+    bool remove(const char* key) { return space->erase(key) > 0; }
+    size_t getBytesLength(const char* key) {
+        auto entry = space->find(key);
+        return entry == space->end() ? 0 : entry->second.size();
+    }
+    size_t getBytes(const char* key, void* buffer, size_t length) {
+        auto entry = space->find(key);
+        if (entry == space->end() || entry->second.size() > length) return 0;
+        memcpy(buffer, entry->second.data(), entry->second.size());
+        return entry->second.size();
+    }
+    size_t putBytes(const char* key, const void* data, size_t length) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        (*space)[key].assign(bytes, bytes + length);
+        return length;
+    }
+};
@@ -0,0 +1,5 @@
+#pragma once
+
+#include <FS.h>
+
+inline fs::HostFS SPIFFS("hmz_spiffs");
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_8BIT (1 << 2)
+
+inline size_t hostHeapAllocations = 0;
+
+inline void* heap_caps_malloc(size_t size, uint32_t) {
+    hostHeapAllocations++;
+    return malloc(size);
+}
+inline void heap_caps_free(void* ptr) { free(ptr); }
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+    ESP_MAC_BT,
+    ESP_MAC_ETH
+} esp_mac_type_t;
+
+// A fixed locally administered address, offset per interface as on the chip
+inline esp_err_t esp_read_mac(uint8_t* mac, esp_mac_type_t type) {
+    const uint8_t base[6] = { 0x02, 0x48, 0x4D, 0x5A, 0x00, 0x01 };
+    memcpy(mac, base, sizeof(base));
+    mac[5] += type;
+    return ESP_OK;
+}
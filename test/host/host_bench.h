@@ -0,0 +1,68 @@
+#pragma once
+
+// Timing and reporting helpers for the env:native benchmark suites. Every
+// result is one "BENCH {json}" line, so `pio test -e native -v | grep '^BENCH '`
+// gives machine-readable results that can be diffed between releases.
+// Include from exactly one file per suite: it replaces operator new.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <chrono>
+#include <new>
+#include <esp_heap_caps.h>
+
+static size_t benchNewCount = 0;
+
+void* operator new(size_t size) {
+    benchNewCount++;
+    void* ptr = malloc(size ? size : 1);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+
+// Heap allocations so far, through new or the frame pool's heap_caps_malloc
+inline size_t benchAllocations() {
+    return benchNewCount + hostHeapAllocations;
+}
+
+inline uint64_t benchNowNs() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Keeps the optimizer from dropping work whose result is otherwise unused
+inline void benchKeep(const void* ptr) {
+    asm volatile("" : : "g"(ptr) : "memory");
+}
+
+class BenchLine {
+private:
+    char line[512];
+    int used;
+
+public:
+    explicit BenchLine(const char* suite) {
+        used = snprintf(line, sizeof(line), "BENCH {\"suite\":\"%s\"", suite);
+    }
+    BenchLine& field(const char* key, const char* value) {
+        used += snprintf(line + used, sizeof(line) - used, ",\"%s\":\"%s\"", key, value);
+        return *this;
+    }
+    BenchLine& field(const char* key, double value) {
+        used += snprintf(line + used, sizeof(line) - used, ",\"%s\":%.3f", key, value);
+        return *this;
+    }
+    BenchLine& field(const char* key, long long value) {
+        used += snprintf(line + used, sizeof(line) - used, ",\"%s\":%lld", key, value);
+        return *this;
+    }
+    BenchLine& field(const char* key, int value) { return field(key, (long long)value); }
+    void print() {
+        printf("%s}\n", line);
+        fflush(stdout);
+    }
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <Preferences.h>
+
+typedef struct {
+    size_t used_entries;
+    size_t free_entries;
+    size_t total_entries;
+    size_t namespace_count;
+} nvs_stats_t;
+
+// A 24 KB partition: 32-byte entries, one per key plus one per 32 bytes of blob
+inline esp_err_t nvs_get_stats(const char*, nvs_stats_t* stats) {
+    stats->total_entries = 24 * 1024 / 32;
+    stats->used_entries = 0;
+    for (const auto& space : hostNvs()) {
+        for (const auto& entry : space.second) stats->used_entries += 1 + (entry.second.size() + 31) / 32;
+    }
+    stats->free_entries = stats->total_entries - stats->used_entries;
+    stats->namespace_count = hostNvs().size();
+    return ESP_OK;
+}
@@ -0,0 +1,81 @@
+// The output stage at 30 to 30,000 pixels: correctPixels() (gamma, white
+// balance, brightness, dither and the channel sum the power limiter reads)
+// against a bare scan that only sums the channels, i.e. what a separate
+// current estimate would cost per published frame. Also checks that the
+// folded sum matches that scan.
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "color_pipeline.h"
+
+static const int PIXEL_COUNTS[] = { 30, 300, 3000, 30000 };
+static const long PIXELS_PER_RUN = 30000000;
+
+static uint32_t rngState = 12345;
+
+static uint8_t nextByte() {
+    rngState = rngState * 1664525 + 1013904223;
+    return rngState >> 24;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static uint32_t sumChannels(const CRGB* pixels, int count) {
+    uint32_t sum = 0;
+    for (int i = 0; i < count; i++) sum += pixels[i].r + pixels[i].g + pixels[i].b;
+    return sum;
+}
+
+static void test_channel_sum_matches_output() {
+    std::vector<CRGB> src(1000), dst(1000);
+    for (CRGB& pixel : src) pixel = CRGB(nextByte(), nextByte(), nextByte());
+    for (uint16_t brightness16 : { 0, 257 * 40, 65535 }) {
+        uint32_t channelSum = 0;
+        correctPixels(src.data(), dst.data(), src.size(), colorLutFor(LedColorProfile::WS2812B),
+                      brightness16, 128, channelSum);
+        TEST_ASSERT_EQUAL_UINT32(sumChannels(dst.data(), dst.size()), channelSum);
+    }
+}
+
+static void test_bench_output_stage() {
+    for (int count : PIXEL_COUNTS) {
+        std::vector<CRGB> src(count), dst(count);
+        for (CRGB& pixel : src) pixel = CRGB(nextByte(), nextByte(), nextByte());
+        const ColorLut& lut = colorLutFor(LedColorProfile::WS2812B);
+        long frames = PIXELS_PER_RUN / count;
+        
+        uint32_t channelSum = 0;
+        uint64_t start = benchNowNs();
+        for (long frame = 0; frame < frames; frame++) {
+            correctPixels(src.data(), dst.data(), count, lut, 200 * 257, nextDitherOffset(), channelSum);
+            benchKeep(dst.data());
+        }
+        double correctNs = (double)(benchNowNs() - start) / frames / count;
+        
+        uint32_t scanSum = 0;
+        start = benchNowNs();
+        for (long frame = 0; frame < frames; frame++) {
+            benchKeep(dst.data());
+            scanSum += sumChannels(dst.data(), count);
+        }
+        double scanNs = (double)(benchNowNs() - start) / frames / count;
+        benchKeep(&scanSum);
+        benchKeep(&channelSum);
+        
+        BenchLine("color_pipeline")
+            .field("pixels", count)
+            .field("correct_ns_per_pixel", correctNs)
+            .field("sum_scan_ns_per_pixel", scanNs)
+            .field("correct_us_per_frame", correctNs * count / 1000)
+            .print();
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_channel_sum_matches_output);
+    RUN_TEST(test_bench_output_stage);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+// Frame cost with 0 to MAX_LAYERS full-strip layers over a base effect, per
+// blend mode, as renderFrame runs it: forced base redraw, then the layers.
+// Every layer runs the same effect, so the step per layer is that effect's
+// redraw plus one blend pass; blend_ns_per_pixel is the step minus the redraw.
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "compositor.h"
+#include "effect_registry.h"
+#include "topology.h"
+
+static const int PIXEL_COUNTS[] = { 300, 1500, MAX_FRAME_LEDS };
+static const uint32_t FRAME_US = 16667;
+static const long PIXELS_PER_RUN = 1000000;
+static const int BENCH_RUNS = 5;            // Best of, to shed scheduler noise
+
+static const AnimationType LAYER_EFFECT = AnimationType::RAINBOW;
+
+struct Frame {
+    std::vector<CRGB> leds;
+    std::vector<uint8_t> hueMap;
+    std::vector<uint8_t> radiusMap;
+    FrameAllocator pool;
+    Compositor compositor;
+    EffectState baseState;
+    
+    explicit Frame(int count) : leds(count), hueMap(count), radiusMap(count) {
+        TopologyConfig config = { TopologyType::STRIP, count, 0, false, nullptr };
+        TopologyMaps maps = { hueMap.data(), radiusMap.data(), nullptr };
+        buildTopologyMaps(config, maps);
+        pool.begin();
+        compositor.begin(count, pool);
+        resetEffectState(baseState);
+    }
+    
+    bool setLayers(int layers, BlendMode mode, uint8_t opacity) {
+        LayerConfig configs[MAX_LAYERS];
+        for (int i = 0; i < layers; i++) {
+            configs[i] = { 0, (int)leds.size(), LAYER_EFFECT, CRGB(0, 80, 255), opacity, mode, true };
+        }
+        return compositor.setLayers(configs, layers);
+    }
+    
+    void render() {
+        int count = leds.size();
+        EffectContext ctx = { leds.data(), hueMap.data(), radiusMap.data(), count, CRGB(255, 96, 0),
+                              200, true, true, FRAME_US, FRAME_US };
+        renderEffect(AnimationType::BREATHE, ctx, baseState);
+        compositor.render(leds.data(), hueMap.data(), radiusMap.data(), 200, FRAME_US, FRAME_US);
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+// One opaque NORMAL layer over the whole strip is the layer's effect alone
+static void test_opaque_layer_replaces_frame() {
+    const int count = 300;
+    Frame frame(count);
+    TEST_ASSERT_TRUE(frame.setLayers(1, BlendMode::NORMAL, 255));
+    frame.render();
+    
+    std::vector<CRGB> expected(count);
+    EffectState state;
+    resetEffectState(state);
+    EffectContext ctx = { expected.data(), frame.hueMap.data(), frame.radiusMap.data(), count,
+                          CRGB(0, 80, 255), 200, true, true, FRAME_US, FRAME_US };
+    renderEffect(LAYER_EFFECT, ctx, state);
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), frame.leds.data(), count * sizeof(CRGB));
+}
+
+static double frameNs(Frame& frame, long frames) {
+    frame.render();
+    double best = 1e18;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = benchNowNs();
+        for (long i = 0; i < frames; i++) {
+            frame.render();
+            benchKeep(frame.leds.data());
+        }
+        best = std::min(best, (double)(benchNowNs() - start) / frames);
+    }
+    return best;
+}
+
+// Forced redraw of the layer effect alone, into a buffer of its own
+static double effectNs(Frame& frame, long frames) {
+    int count = frame.leds.size();
+    std::vector<CRGB> buffer(count);
+    EffectState state;
+    resetEffectState(state);
+    EffectContext ctx = { buffer.data(), frame.hueMap.data(), frame.radiusMap.data(), count,
+                          CRGB(0, 80, 255), 200, true, true, FRAME_US, FRAME_US };
+    double best = 1e18;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = benchNowNs();
+        for (long i = 0; i < frames; i++) {
+            renderEffect(LAYER_EFFECT, ctx, state);
+            benchKeep(buffer.data());
+        }
+        best = std::min(best, (double)(benchNowNs() - start) / frames);
+    }
+    return best;
+}
+
+static void test_layer_cost() {
+    struct Blend { BlendMode mode; uint8_t opacity; const char* name; };
+    const Blend blends[] = {
+        { BlendMode::NORMAL, 255, "normal_opaque" },
+        { BlendMode::NORMAL, 128, "normal" },
+        { BlendMode::ADD, 128, "add" },
+        { BlendMode::MULTIPLY, 128, "multiply" },
+        { BlendMode::MAX, 128, "max" },
+    };
+    for (int count : PIXEL_COUNTS) {
+        long frames = PIXELS_PER_RUN / count;
+        for (const Blend& blend : blends) {
+            Frame frame(count);
+            double effect = effectNs(frame, frames);
+            double previousNs = 0;
+            for (int layers = 0; layers <= MAX_LAYERS; layers++) {
+                TEST_ASSERT_TRUE(frame.setLayers(layers, blend.mode, blend.opacity));
+                size_t allocations = benchAllocations();
+                double ns = frameNs(frame, frames);
+                TEST_ASSERT_EQUAL(0, benchAllocations() - allocations);
+                
+                BenchLine("compositor")
+                    .field("blend", blend.name)
+                    .field("pixels", count)
+                    .field("layers", layers)
+                    .field("frame_ns_per_pixel", ns / count)
+                    .field("layer_ns_per_pixel", layers ? (ns - previousNs) / count : 0.0)
+                    .field("blend_ns_per_pixel", layers ? (ns - previousNs - effect) / count : 0.0)
+                    .field("fps", 1e9 / ns)
+                    .print();
+                previousNs = ns;
+            }
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_opaque_layer_replaces_frame);
+    RUN_TEST(test_layer_cost);
+    return UNITY_END();
+}
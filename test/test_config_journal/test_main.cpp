@@ -0,0 +1,199 @@
+// The config journal on a RAM backend: changes replayed on top of the
+// snapshot at boot, recovery from a torn or corrupt append, stale journals
+// from an interrupted compaction, and compaction past the size threshold.
+
+#include <unity.h>
+#include <vector>
+#include "device_config.h"
+
+void setUp() {}
+void tearDown() {}
+
+static std::vector<uint8_t> readFile(StorageBackend& backend, const char* path) {
+    std::vector<uint8_t> data(backend.size(path));
+    data.resize(backend.read(path, 0, data.data(), data.size()));
+    return data;
+}
+
+static String macFor(int i) {
+    char mac[18];
+    snprintf(mac, sizeof(mac), "AA:BB:CC:00:%02X:%02X", (i >> 8) & 0xFF, i & 0xFF);
+    return mac;
+}
+
+// Defaults plus one device, compacted so the journal starts empty
+static void openCompacted(MemoryBackend& backend, PersistentStorage& store) {
+    backend.format();
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_TRUE(store.addDevice("Porch", "strip", "SK6812", 144, macFor(1)));
+    TEST_ASSERT_TRUE(store.compact());
+    TEST_ASSERT_FALSE(backend.exists("/config.log"));
+}
+
+static void test_changes_replay_from_journal() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openCompacted(backend, store);
+    std::vector<uint8_t> snapshot = readFile(backend, "/config.bin");
+    
+    TEST_ASSERT_TRUE(store.addDevice("Peer", "bar", "WS2811", 60, macFor(2)));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Porch", "num_of_leds", 150));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Porch", "room", "kitchen"));
+    TEST_ASSERT_TRUE(store.flush());
+    TEST_ASSERT_TRUE(store.removeDevice("LEDStrip1"));
+    TEST_ASSERT_TRUE(store.addNetwork("Garage", "s3cret"));
+    TEST_ASSERT_TRUE(store.removeNetwork("HomeNetwork"));
+    TEST_ASSERT_TRUE(store.flush());
+    String expected = store.getAllDataCompact();
+    
+    // Two appends, and the snapshot untouched
+    TEST_ASSERT_EQUAL(2, store.getStats().journalAppends);
+    TEST_ASSERT_TRUE(readFile(backend, "/config.bin") == snapshot);
+    TEST_ASSERT_TRUE(backend.size("/config.log") > sizeof(JournalFileHeader));
+    
+    PersistentStorage reopened(backend);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_TRUE(reopened.getAllDataCompact() == expected);
+    TEST_ASSERT_FALSE(reopened.deviceExists("LEDStrip1"));
+    TEST_ASSERT_EQUAL(150, reopened.getDeviceConfig(0).numLeds);
+    TEST_ASSERT_FALSE(reopened.isDirty());
+}
+
+// A power cut during an append leaves a short last record; replay keeps
+// everything before it and starts a clean journal
+static void test_torn_append_is_dropped() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openCompacted(backend, store);
+    TEST_ASSERT_TRUE(store.addDevice("Kept", "strip", "WS2812B", 30, macFor(2)));
+    TEST_ASSERT_TRUE(store.flush());
+    String expected = store.getAllDataCompact();
+    TEST_ASSERT_TRUE(store.addDevice("Torn", "strip", "WS2812B", 30, macFor(3)));
+    TEST_ASSERT_TRUE(store.flush());
+    
+    std::vector<uint8_t> log = readFile(backend, "/config.log");
+    log.resize(log.size() - 7);
+    backend.write("/config.log", log.data(), log.size());
+    
+    PersistentStorage reopened(backend);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_TRUE(reopened.getAllDataCompact() == expected);
+    TEST_ASSERT_FALSE(reopened.deviceExists("Torn"));
+    TEST_ASSERT_EQUAL(1, reopened.getStats().compactions);
+    TEST_ASSERT_FALSE(backend.exists("/config.log"));
+    
+    // New changes append to the fresh journal and survive the next boot
+    TEST_ASSERT_TRUE(reopened.addDevice("Later", "strip", "WS2812B", 30, macFor(4)));
+    TEST_ASSERT_TRUE(reopened.flush());
+    PersistentStorage again(backend);
+    TEST_ASSERT_TRUE(again.begin());
+    TEST_ASSERT_TRUE(again.deviceExists("Kept"));
+    TEST_ASSERT_TRUE(again.deviceExists("Later"));
+}
+
+// A record whose CRC fails ends replay there, even if later records are intact
+static void test_corrupt_record_ends_replay() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openCompacted(backend, store);
+    TEST_ASSERT_TRUE(store.addDevice("First", "strip", "WS2812B", 30, macFor(2)));
+    TEST_ASSERT_TRUE(store.flush());
+    size_t firstEnd = backend.size("/config.log");
+    TEST_ASSERT_TRUE(store.addDevice("Second", "strip", "WS2812B", 30, macFor(3)));
+    TEST_ASSERT_TRUE(store.addDevice("Third", "strip", "WS2812B", 30, macFor(4)));
+    TEST_ASSERT_TRUE(store.flush());
+    
+    std::vector<uint8_t> log = readFile(backend, "/config.log");
+    log[firstEnd + sizeof(JournalRecordHeader) + 3] ^= 0x20;
+    backend.write("/config.log", log.data(), log.size());
+    
+    PersistentStorage reopened(backend);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_TRUE(reopened.deviceExists("First"));
+    TEST_ASSERT_FALSE(reopened.deviceExists("Second"));
+    TEST_ASSERT_FALSE(reopened.deviceExists("Third"));
+}
+
+// A journal for an older snapshot (compaction cut after the rename) is ignored
+static void test_stale_journal_is_discarded() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openCompacted(backend, store);
+    TEST_ASSERT_TRUE(store.addDevice("Folded", "strip", "WS2812B", 30, macFor(2)));
+    TEST_ASSERT_TRUE(store.flush());
+    std::vector<uint8_t> staleLog = readFile(backend, "/config.log");
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Folded", "num_of_leds", 99));
+    TEST_ASSERT_TRUE(store.flush());
+    TEST_ASSERT_TRUE(store.compact());
+    backend.write("/config.log", staleLog.data(), staleLog.size());
+    
+    PersistentStorage reopened(backend);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_FALSE(backend.exists("/config.log"));
+    TEST_ASSERT_EQUAL(99, reopened.getDeviceConfig(2).numLeds);
+}
+
+// A compaction cut between writing /config.tmp and renaming it
+static void test_interrupted_compaction_is_finished() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openCompacted(backend, store);
+    TEST_ASSERT_TRUE(store.addDevice("New", "strip", "WS2812B", 30, macFor(2)));
+    TEST_ASSERT_TRUE(store.compact());
+    String expected = store.getAllDataCompact();
+    
+    // SPIFFS removes the old snapshot before the rename; only the temp file is left
+    TEST_ASSERT_TRUE(backend.rename("/config.bin", "/config.tmp"));
+    PersistentStorage renamed(backend);
+    TEST_ASSERT_TRUE(renamed.begin());
+    TEST_ASSERT_TRUE(renamed.getAllDataCompact() == expected);
+    TEST_ASSERT_FALSE(backend.exists("/config.tmp"));
+    
+    // Cut before the rename: the old snapshot stands and the partial temp file goes
+    const uint8_t partial[] = { 0x48, 0x4D, 0x46 };
+    backend.write("/config.tmp", partial, sizeof(partial));
+    PersistentStorage kept(backend);
+    TEST_ASSERT_TRUE(kept.begin());
+    TEST_ASSERT_TRUE(kept.getAllDataCompact() == expected);
+    TEST_ASSERT_FALSE(backend.exists("/config.tmp"));
+}
+
+// Once the journal passes JOURNAL_COMPACT_BYTES, loop() folds it into a new snapshot
+static void test_journal_compacts_past_threshold() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openCompacted(backend, store);
+    uint32_t compactions = store.getStats().compactions;
+    
+    int updates = 0;
+    while (backend.size("/config.log") <= JOURNAL_COMPACT_BYTES) {
+        TEST_ASSERT_TRUE(store.updateDeviceProperty("Porch", "num_of_leds", 100 + updates++));
+        TEST_ASSERT_TRUE(store.flush());
+        TEST_ASSERT_TRUE(updates < 1000);
+    }
+    TEST_ASSERT_EQUAL(compactions, store.getStats().compactions);
+    String expected = store.getAllDataCompact();
+    
+    store.loop();
+    TEST_ASSERT_EQUAL(compactions, store.getStats().compactions);    // Waits out the debounce
+    hostAdvanceClock(FLUSH_DEBOUNCE_MS);
+    store.loop();
+    TEST_ASSERT_EQUAL(compactions + 1, store.getStats().compactions);
+    TEST_ASSERT_FALSE(backend.exists("/config.log"));
+    
+    PersistentStorage reopened(backend);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_TRUE(reopened.getAllDataCompact() == expected);
+    TEST_ASSERT_EQUAL(100 + updates - 1, reopened.getDeviceConfig(1).numLeds);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_changes_replay_from_journal);
+    RUN_TEST(test_torn_append_is_dropped);
+    RUN_TEST(test_corrupt_record_ends_replay);
+    RUN_TEST(test_stale_journal_is_discarded);
+    RUN_TEST(test_interrupted_compaction_is_finished);
+    RUN_TEST(test_journal_compacts_past_threshold);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+// PersistentStorage write batching on a RAM backend: the flush debounce,
+// transactions that hold back flushes until the outermost commit, and
+// rollback to the state before the transaction.
+
+#include <unity.h>
+#include <vector>
+#include "device_config.h"
+
+void setUp() {}
+void tearDown() {}
+
+static String macFor(int i) {
+    char mac[18];
+    snprintf(mac, sizeof(mac), "AA:BB:CC:00:%02X:%02X", (i >> 8) & 0xFF, i & 0xFF);
+    return mac;
+}
+
+// Opens a store on a fresh backend with its defaults already flushed
+static void openFresh(MemoryBackend& backend, PersistentStorage& store) {
+    backend.format();
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_FALSE(store.isDirty());
+}
+
+static void test_changes_wait_for_quiet() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openFresh(backend, store);
+    uint32_t flushes = store.getStats().flushes;
+    
+    TEST_ASSERT_TRUE(store.addDevice("Peer0", "strip", "WS2812B", 30, macFor(0)));
+    store.loop();
+    TEST_ASSERT_EQUAL(flushes, store.getStats().flushes);
+    hostAdvanceClock(FLUSH_DEBOUNCE_MS / 2);
+    TEST_ASSERT_TRUE(store.addDevice("Peer1", "strip", "WS2812B", 30, macFor(1)));
+    hostAdvanceClock(FLUSH_DEBOUNCE_MS / 2);
+    store.loop();
+    TEST_ASSERT_TRUE(store.isDirty());
+    
+    hostAdvanceClock(FLUSH_DEBOUNCE_MS);
+    store.loop();
+    TEST_ASSERT_FALSE(store.isDirty());
+    TEST_ASSERT_EQUAL(flushes + 1, store.getStats().flushes);
+}
+
+// A steady trickle of changes still reaches flash within FLUSH_MAX_DELAY_MS
+static void test_continuous_changes_flush_by_max_delay() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openFresh(backend, store);
+    uint32_t flushes = store.getStats().flushes;
+    
+    unsigned long waited = 0;
+    for (int i = 0; store.getStats().flushes == flushes; i++) {
+        TEST_ASSERT_TRUE(waited <= FLUSH_MAX_DELAY_MS);
+        TEST_ASSERT_TRUE(store.updateDeviceProperty("LEDStrip1", "num_of_leds", 31 + i));
+        hostAdvanceClock(FLUSH_DEBOUNCE_MS / 2);
+        waited += FLUSH_DEBOUNCE_MS / 2;
+        store.loop();
+    }
+    TEST_ASSERT_FALSE(store.isDirty());
+}
+
+// 40 records pushed at once cost one flash write
+static void test_transaction_flushes_once() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openFresh(backend, store);
+    StorageStats before = store.getStats();
+    
+    store.beginTransaction();
+    for (int i = 0; i < 40; i++) {
+        TEST_ASSERT_TRUE(store.addDevice("Peer" + String(i), "strip", "WS2812B", 30, macFor(i)));
+    }
+    hostAdvanceClock(FLUSH_MAX_DELAY_MS * 2);
+    store.loop();
+    TEST_ASSERT_EQUAL(before.flushes, store.getStats().flushes);
+    TEST_ASSERT_TRUE(store.commitTransaction());
+    store.loop();
+    
+    StorageStats after = store.getStats();
+    TEST_ASSERT_EQUAL(before.mutations + 40, after.mutations);
+    TEST_ASSERT_EQUAL(before.flushes + 1, after.flushes);
+    // Past JOURNAL_COMPACT_BYTES the batch goes out as one snapshot instead of one append
+    TEST_ASSERT_EQUAL(before.journalAppends + before.compactions + 1, after.journalAppends + after.compactions);
+    
+    PersistentStorage reopened(backend);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_EQUAL(41, reopened.getDeviceCount());
+}
+
+static void test_nested_transactions_flush_at_outermost_commit() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openFresh(backend, store);
+    uint32_t flushes = store.getStats().flushes;
+    
+    store.beginTransaction();
+    store.beginTransaction();
+    TEST_ASSERT_TRUE(store.addNetwork("Inner", "pw"));
+    store.commitTransaction();
+    hostAdvanceClock(FLUSH_MAX_DELAY_MS * 2);
+    store.loop();
+    TEST_ASSERT_EQUAL(flushes, store.getStats().flushes);
+    store.commitTransaction();
+    store.loop();
+    TEST_ASSERT_EQUAL(flushes + 1, store.getStats().flushes);
+}
+
+static void test_rollback_restores_state_before_transaction() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openFresh(backend, store);
+    TEST_ASSERT_TRUE(store.addDevice("Porch", "strip", "SK6812", 144, macFor(1)));
+    TEST_ASSERT_TRUE(store.flush());
+    // Queued but not yet flushed when the transaction starts; it survives the rollback
+    TEST_ASSERT_TRUE(store.addDevice("Queued", "strip", "WS2812B", 30, macFor(2)));
+    String before = store.getAllDataCompact();
+    
+    store.beginTransaction();
+    TEST_ASSERT_TRUE(store.addDevice("Doomed", "strip", "WS2812B", 30, macFor(3)));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Porch", "num_of_leds", 10));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Queued", "room", "hall"));
+    TEST_ASSERT_TRUE(store.removeNetwork("HomeNetwork"));
+    TEST_ASSERT_TRUE(store.rollbackTransaction());
+    
+    TEST_ASSERT_TRUE(store.getAllDataCompact() == before);
+    TEST_ASSERT_FALSE(store.deviceExists("Doomed"));
+    TEST_ASSERT_TRUE(store.deviceExists("Queued"));
+    TEST_ASSERT_TRUE(store.isDirty());
+    TEST_ASSERT_FALSE(store.rollbackTransaction());
+    
+    TEST_ASSERT_TRUE(store.flush());
+    PersistentStorage reopened(backend);
+    TEST_ASSERT_TRUE(reopened.begin());
+    TEST_ASSERT_TRUE(reopened.getAllDataCompact() == before);
+}
+
+// Once flush() has written part of a transaction there is nothing to roll back to
+static void test_rollback_after_flush_keeps_changes() {
+    MemoryBackend backend;
+    PersistentStorage store(backend);
+    openFresh(backend, store);
+    
+    store.beginTransaction();
+    TEST_ASSERT_TRUE(store.addDevice("Flushed", "strip", "WS2812B", 30, macFor(4)));
+    TEST_ASSERT_TRUE(store.flush());
+    TEST_ASSERT_TRUE(store.addDevice("After", "strip", "WS2812B", 30, macFor(5)));
+    TEST_ASSERT_FALSE(store.rollbackTransaction());
+    TEST_ASSERT_TRUE(store.deviceExists("Flushed"));
+    TEST_ASSERT_TRUE(store.deviceExists("After"));
+    
+    // The transaction is closed either way, so loop() flushes again
+    hostAdvanceClock(FLUSH_DEBOUNCE_MS);
+    store.loop();
+    TEST_ASSERT_FALSE(store.isDirty());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_changes_wait_for_quiet);
+    RUN_TEST(test_continuous_changes_flush_by_max_delay);
+    RUN_TEST(test_transaction_flushes_once);
+    RUN_TEST(test_nested_transactions_flush_at_outermost_commit);
+    RUN_TEST(test_rollback_restores_state_before_transaction);
+    RUN_TEST(test_rollback_after_flush_keeps_changes);
+    return UNITY_END();
+}
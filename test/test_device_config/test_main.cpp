@@ -0,0 +1,225 @@
+// The binary config format through PersistentStorage on a RAM backend: a
+// snapshot round trip, records refused when they don't fit, migration from
+// the JSON file and from an older schema, and a newer schema opened
+// read-only and never rewritten.
+
+#include <unity.h>
+#include <vector>
+#include "device_config.h"
+
+void setUp() {}
+void tearDown() {}
+
+static std::vector<uint8_t> readFile(StorageBackend& backend, const char* path) {
+    std::vector<uint8_t> data(backend.size(path));
+    data.resize(backend.read(path, 0, data.data(), data.size()));
+    return data;
+}
+
+static ConfigFileHeader headerOf(const std::vector<uint8_t>& image) {
+    ConfigFileHeader header = {};
+    memcpy(&header, image.data(), min(image.size(), sizeof(header)));
+    return header;
+}
+
+static void sealHeader(std::vector<uint8_t>& image, ConfigFileHeader header) {
+    header.headerCrc = configCrc32(&header, offsetof(ConfigFileHeader, headerCrc));
+    memcpy(image.data(), &header, sizeof(header));
+}
+
+// A snapshot with three devices (typed fields, a matrix, an extra key) and two networks
+static void writeSampleConfig(StorageBackend& backend) {
+    backend.format();
+    PersistentStorage store(backend);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_TRUE(store.addDevice("Porch", "strip", "SK6812", 144, "AA:BB:CC:00:00:01"));
+    TEST_ASSERT_TRUE(store.addDevice("Panel", "matrix", "WS2812B", 256, "AA:BB:CC:00:00:02"));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Panel", "matrix_width", 16));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Panel", "data_pin", 5));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Porch", "power_budget_ma", 2500));
+    TEST_ASSERT_TRUE(store.updateDeviceProperty("Porch", "room", "kitchen"));
+    TEST_ASSERT_TRUE(store.addNetwork("Garage", "s3cret"));
+    TEST_ASSERT_TRUE(store.compact());
+}
+
+static void test_snapshot_round_trip() {
+    MemoryBackend backend;
+    writeSampleConfig(backend);
+    String expected;
+    {
+        PersistentStorage store(backend);
+        TEST_ASSERT_TRUE(store.begin());
+        expected = store.getAllDataCompact();
+    }
+    TEST_ASSERT_FALSE(backend.exists("/config.log"));
+    
+    PersistentStorage store(backend);
+    TEST_ASSERT_TRUE(store.begin());
+    // Boot reads the header and record table only; strings wait for first use
+    TEST_ASSERT_TRUE(store.getStats().bytesRead < backend.size("/config.bin"));
+    TEST_ASSERT_EQUAL(3, store.getDeviceCount());
+    TEST_ASSERT_EQUAL(2, store.getNetworkCount());
+    TEST_ASSERT_EQUAL(5, store.getDeviceDataPin(2));
+    const DeviceConfig& panel = store.getDeviceConfig(2);
+    TEST_ASSERT_EQUAL_STRING("Panel", panel.name.c_str());
+    TEST_ASSERT_EQUAL(256, panel.numLeds);
+    TEST_ASSERT_EQUAL(16, panel.matrixWidth);
+    TEST_ASSERT_TRUE(panel.serpentine);
+    const DeviceConfig& porch = store.getDeviceConfig(1);
+    TEST_ASSERT_EQUAL(2500, porch.powerBudgetMa);
+    TEST_ASSERT_EQUAL_STRING("{\"room\":\"kitchen\"}", porch.extra.c_str());
+    TEST_ASSERT_TRUE(store.getAllDataCompact() == expected);
+    TEST_ASSERT_FALSE(store.isDirty());
+}
+
+// DeviceRecord holds 16-bit fields; wider values are refused, not truncated
+static void test_out_of_range_device_is_rejected() {
+    MemoryBackend backend;
+    writeSampleConfig(backend);
+    PersistentStorage store(backend);
+    TEST_ASSERT_TRUE(store.begin());
+    
+    TEST_ASSERT_FALSE(store.addDevice("Huge", "strip", "WS2812B", 70000, "AA:BB:CC:00:00:09"));
+    TEST_ASSERT_FALSE(store.deviceExists("Huge"));
+    TEST_ASSERT_FALSE(store.updateDeviceProperty("Porch", "num_of_leds", 65536));
+    TEST_ASSERT_FALSE(store.updateDeviceProperty("Porch", "data_pin", 40000));
+    TEST_ASSERT_FALSE(store.updateDeviceProperty("Porch", "power_budget_ma", -1));
+    TEST_ASSERT_FALSE(store.updateDeviceProperty("Porch", "room", String(std::string(70000, 'x'))));
+    TEST_ASSERT_FALSE(store.isDirty());
+    
+    const DeviceConfig& porch = store.getDeviceConfig(1);
+    TEST_ASSERT_EQUAL(144, porch.numLeds);
+    TEST_ASSERT_EQUAL(-1, porch.dataPin);
+    TEST_ASSERT_EQUAL(2500, porch.powerBudgetMa);
+    TEST_ASSERT_EQUAL(3, store.getDeviceCount());
+}
+
+static void test_json_config_is_migrated() {
+    MemoryBackend backend;
+    const char* json =
+        "{\"devices\":[{\"device_name\":\"Legacy\",\"device_type\":\"strip\",\"led_type\":\"WS2811\","
+        "\"num_of_leds\":60,\"mac_address\":\"AA:BB:CC:00:00:10\",\"power_budget_ma\":800,\"zone\":3}],"
+        "\"networks\":[{\"ssid\":\"Home\",\"password\":\"pw\"}]}";
+    backend.write("/config.json", (const uint8_t*)json, strlen(json));
+    {
+        PersistentStorage store(backend);
+        TEST_ASSERT_TRUE(store.begin());
+    }
+    TEST_ASSERT_TRUE(backend.exists("/config.bin"));
+    TEST_ASSERT_FALSE(backend.exists("/config.json"));
+    TEST_ASSERT_TRUE(backend.exists("/config.json.bak"));
+    
+    PersistentStorage store(backend);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_EQUAL(1, store.getDeviceCount());
+    const DeviceConfig& legacy = store.getDeviceConfig(0);
+    TEST_ASSERT_EQUAL_STRING("Legacy", legacy.name.c_str());
+    TEST_ASSERT_EQUAL_STRING("WS2811", legacy.ledType.c_str());
+    TEST_ASSERT_EQUAL(60, legacy.numLeds);
+    TEST_ASSERT_EQUAL(800, legacy.powerBudgetMa);
+    TEST_ASSERT_EQUAL_STRING("{\"zone\":3}", legacy.extra.c_str());
+    TEST_ASSERT_TRUE(store.networkExists("Home"));
+}
+
+static void test_older_schema_is_upgraded() {
+    MemoryBackend backend;
+    writeSampleConfig(backend);
+    std::vector<uint8_t> image = readFile(backend, "/config.bin");
+    ConfigFileHeader header = headerOf(image);
+    header.schemaVersion = CONFIG_SCHEMA_VERSION - 1;
+    sealHeader(image, header);
+    backend.write("/config.bin", image.data(), image.size());
+    
+    String expected;
+    {
+        PersistentStorage store(backend);
+        TEST_ASSERT_TRUE(store.begin());
+        TEST_ASSERT_FALSE(store.isReadOnly());
+        TEST_ASSERT_TRUE(store.isDirty());
+        expected = store.getAllDataCompact();
+        TEST_ASSERT_TRUE(store.flush());
+    }
+    TEST_ASSERT_EQUAL(CONFIG_SCHEMA_VERSION, headerOf(readFile(backend, "/config.bin")).schemaVersion);
+    
+    PersistentStorage store(backend);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_FALSE(store.isDirty());
+    TEST_ASSERT_TRUE(store.getAllDataCompact() == expected);
+}
+
+// Rewrites the sample snapshot as schema v+1 with 4 bytes appended to each device record
+static std::vector<uint8_t> newerSchemaImage(StorageBackend& backend) {
+    std::vector<uint8_t> current = readFile(backend, "/config.bin");
+    ConfigFileHeader header = headerOf(current);
+    size_t deviceBytes = (size_t)header.deviceCount * header.deviceRecordSize;
+    const uint8_t appended[4] = { 0xAB, 0xCD, 0xEF, 0x01 };
+    
+    std::vector<uint8_t> table;
+    for (size_t i = 0; i < header.deviceCount; i++) {
+        const uint8_t* record = current.data() + sizeof(header) + i * header.deviceRecordSize;
+        table.insert(table.end(), record, record + header.deviceRecordSize);
+        table.insert(table.end(), appended, appended + sizeof(appended));
+    }
+    table.insert(table.end(), current.begin() + sizeof(header) + deviceBytes,
+                 current.begin() + header.stringsOffset);
+    
+    header.schemaVersion = CONFIG_SCHEMA_VERSION + 1;
+    header.deviceRecordSize += sizeof(appended);
+    header.stringsOffset = sizeof(header) + table.size();
+    header.recordsCrc = configCrc32(table.data(), table.size());
+    std::vector<uint8_t> image(sizeof(header));
+    image.insert(image.end(), table.begin(), table.end());
+    image.insert(image.end(), current.begin() + headerOf(current).stringsOffset, current.end());
+    sealHeader(image, header);
+    return image;
+}
+
+static void test_newer_schema_opens_read_only() {
+    MemoryBackend backend;
+    writeSampleConfig(backend);
+    std::vector<uint8_t> image = newerSchemaImage(backend);
+    backend.write("/config.bin", image.data(), image.size());
+    
+    PersistentStorage store(backend);
+    TEST_ASSERT_TRUE(store.begin());
+    TEST_ASSERT_TRUE(store.isReadOnly());
+    TEST_ASSERT_EQUAL(3, store.getDeviceCount());
+    TEST_ASSERT_EQUAL_STRING("Panel", store.getDeviceConfig(2).name.c_str());
+    TEST_ASSERT_EQUAL(16, store.getDeviceConfig(2).matrixWidth);
+    TEST_ASSERT_TRUE(store.networkExists("Garage"));
+    
+    TEST_ASSERT_FALSE(store.addDevice("New", "strip", "WS2812B", 30, "AA:BB:CC:00:00:20"));
+    TEST_ASSERT_FALSE(store.removeNetwork("Garage"));
+    TEST_ASSERT_FALSE(store.compact());
+    TEST_ASSERT_FALSE(store.clearAll());
+    store.flush();
+    store.loop();
+    TEST_ASSERT_TRUE(readFile(backend, "/config.bin") == image);
+    TEST_ASSERT_FALSE(backend.exists("/config.log"));
+    TEST_ASSERT_FALSE(backend.exists("/config.tmp"));
+}
+
+static void test_damaged_newer_schema_is_left_in_place() {
+    MemoryBackend backend;
+    writeSampleConfig(backend);
+    std::vector<uint8_t> image = newerSchemaImage(backend);
+    image[sizeof(ConfigFileHeader) + 2] ^= 0xFF;    // Breaks the record table CRC
+    backend.write("/config.bin", image.data(), image.size());
+    
+    PersistentStorage store(backend);
+    TEST_ASSERT_FALSE(store.begin());
+    TEST_ASSERT_FALSE(store.isReady());
+    TEST_ASSERT_TRUE(readFile(backend, "/config.bin") == image);
+    TEST_ASSERT_FALSE(backend.exists("/config.tmp"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_snapshot_round_trip);
+    RUN_TEST(test_out_of_range_device_is_rejected);
+    RUN_TEST(test_json_config_is_migrated);
+    RUN_TEST(test_older_schema_is_upgraded);
+    RUN_TEST(test_newer_schema_opens_read_only);
+    RUN_TEST(test_damaged_newer_schema_is_left_in_place);
+    return UNITY_END();
+}
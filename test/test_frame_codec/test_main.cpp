@@ -0,0 +1,279 @@
+// Frame codec round trips for every mode, rejection of malformed payloads,
+// and encoded size / decode cost on frames rendered by the real effects.
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "frame_codec.h"
+#include "effect_registry.h"
+#include "topology.h"
+
+static uint32_t rngState = 12345;
+
+static uint8_t nextByte() {
+    rngState = rngState * 1664525 + 1013904223;
+    return rngState >> 24;
+}
+
+// Runs of random length (1 to 200) of random colors, plus some noise
+static std::vector<CRGB> makeFrame(int count) {
+    std::vector<CRGB> frame(count);
+    int i = 0;
+    while (i < count) {
+        int run = 1 + nextByte() % 200;
+        CRGB color(nextByte(), nextByte(), nextByte());
+        for (int j = 0; j < run && i < count; j++, i++) {
+            frame[i] = (nextByte() < 32) ? CRGB(nextByte(), nextByte(), nextByte()) : color;
+        }
+    }
+    return frame;
+}
+
+static size_t worstCaseSize(int count, size_t itemSize) {
+    // Every op carries at least one item, so literals are the upper bound
+    return count * itemSize + (count + FRAME_CODEC_MAX_RUN - 1) / FRAME_CODEC_MAX_RUN + 16;
+}
+
+static void assertFramesEqual(const std::vector<CRGB>& expected, const std::vector<CRGB>& actual) {
+    TEST_ASSERT_EQUAL(expected.size(), actual.size());
+    TEST_ASSERT_EQUAL_MEMORY(expected.data(), actual.data(), expected.size() * sizeof(CRGB));
+}
+
+static void roundTripRle(const std::vector<CRGB>& frame) {
+    int count = frame.size();
+    std::vector<uint8_t> encoded(worstCaseSize(count, 3));
+    size_t length = encodeFrame(FrameCodecMode::RLE, frame.data(), nullptr, count,
+                                encoded.data(), encoded.size());
+    TEST_ASSERT_GREATER_THAN(0, length);
+    
+    std::vector<CRGB> decoded(count, CRGB(1, 2, 3));
+    TEST_ASSERT_TRUE(decodeFrame(FrameCodecMode::RLE, encoded.data(), length,
+                                 decoded.data(), count, nullptr));
+    assertFramesEqual(frame, decoded);
+}
+
+static void roundTripDelta(const std::vector<CRGB>& previous, const std::vector<CRGB>& frame) {
+    int count = frame.size();
+    std::vector<uint8_t> encoded(worstCaseSize(count, 3));
+    size_t length = encodeFrame(FrameCodecMode::DELTA_RLE, frame.data(), previous.data(), count,
+                                encoded.data(), encoded.size());
+    TEST_ASSERT_GREATER_THAN(0, length);
+    
+    // The receiver still holds the previous frame
+    std::vector<CRGB> decoded = previous;
+    TEST_ASSERT_TRUE(decodeFrame(FrameCodecMode::DELTA_RLE, encoded.data(), length,
+                                 decoded.data(), count, nullptr));
+    assertFramesEqual(frame, decoded);
+}
+
+void setUp() {
+    rngState = 12345;
+}
+
+void tearDown() {}
+
+static void test_rle_round_trip() {
+    const int counts[] = { 1, 2, 63, 64, 65, 300, 4097, 30000 };
+    for (int count : counts) {
+        roundTripRle(makeFrame(count));
+        roundTripRle(std::vector<CRGB>(count, CRGB(10, 20, 30)));
+        
+        std::vector<CRGB> noise(count);
+        for (CRGB& pixel : noise) pixel = CRGB(nextByte(), nextByte(), nextByte());
+        roundTripRle(noise);
+    }
+}
+
+static void test_rle_long_runs_use_repeats() {
+    std::vector<CRGB> frame(1000, CRGB::Red);
+    uint8_t encoded[64];
+    size_t length = encodeFrame(FrameCodecMode::RLE, frame.data(), nullptr, 1000, encoded, sizeof(encoded));
+    // 1000 pixels = 16 repeat ops of at most 64, 4 bytes each
+    TEST_ASSERT_EQUAL(16 * 4, length);
+    roundTripRle(frame);
+}
+
+static void test_delta_round_trip() {
+    const int counts[] = { 1, 64, 300, 4097, 30000 };
+    for (int count : counts) {
+        std::vector<CRGB> previous = makeFrame(count);
+        
+        // Sparse changes, dense changes and a fully replaced frame
+        std::vector<CRGB> sparse = previous;
+        for (int i = 0; i < count; i += 97) sparse[i] = CRGB(nextByte(), nextByte(), nextByte());
+        roundTripDelta(previous, sparse);
+        
+        std::vector<CRGB> dense = previous;
+        for (CRGB& pixel : dense) if (nextByte() < 128) pixel.g ^= 0x55;
+        roundTripDelta(previous, dense);
+        
+        roundTripDelta(previous, makeFrame(count));
+    }
+}
+
+static void test_delta_unchanged_frame_is_skips() {
+    std::vector<CRGB> frame = makeFrame(30000);
+    uint8_t encoded[16];
+    size_t length = encodeFrame(FrameCodecMode::DELTA_RLE, frame.data(), frame.data(), 30000,
+                                encoded, sizeof(encoded));
+    // 30000 = 7 long skips of 64*64 + one of 20*64 + a short skip of 48
+    TEST_ASSERT_EQUAL(9, length);
+    roundTripDelta(frame, frame);
+}
+
+static void test_indexed_round_trip() {
+    CRGB palette[256];
+    for (int i = 0; i < 256; i++) palette[i] = CRGB(i, 255 - i, i ^ 0x5A);
+    
+    const int counts[] = { 1, 64, 300, 30000 };
+    for (int count : counts) {
+        std::vector<uint8_t> indices(count);
+        for (int i = 0; i < count; i++) indices[i] = (i / 7) % 3 == 0 ? 42 : nextByte();
+        
+        std::vector<uint8_t> encoded(worstCaseSize(count, 1));
+        size_t length = encodeIndexedFrame(indices.data(), count, encoded.data(), encoded.size());
+        TEST_ASSERT_GREATER_THAN(0, length);
+        
+        std::vector<CRGB> decoded(count);
+        TEST_ASSERT_TRUE(decodeFrame(FrameCodecMode::INDEXED_RLE, encoded.data(), length,
+                                     decoded.data(), count, palette));
+        for (int i = 0; i < count; i++) {
+            TEST_ASSERT_TRUE(decoded[i] == palette[indices[i]]);
+        }
+    }
+}
+
+static void test_encode_rejects_small_buffer() {
+    std::vector<CRGB> frame = makeFrame(300);
+    uint8_t encoded[32];
+    TEST_ASSERT_EQUAL(0, encodeFrame(FrameCodecMode::RLE, frame.data(), nullptr, 300,
+                                     encoded, sizeof(encoded)));
+    // DELTA_RLE needs the previous frame
+    TEST_ASSERT_EQUAL(0, encodeFrame(FrameCodecMode::DELTA_RLE, frame.data(), nullptr, 300,
+                                     encoded, sizeof(encoded)));
+}
+
+static void test_decode_rejects_malformed() {
+    CRGB dst[8];
+    CRGB palette[256] = {};
+    
+    // Literal of 2 pixels with only one pixel of data
+    const uint8_t truncatedLiteral[] = { 0x01, 1, 2, 3 };
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::RLE, truncatedLiteral, sizeof(truncatedLiteral), dst, 8, nullptr));
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::DELTA_RLE, truncatedLiteral, sizeof(truncatedLiteral), dst, 8, nullptr));
+    
+    // Repeat with a partial item
+    const uint8_t truncatedRepeat[] = { 0x43, 1, 2 };
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::RLE, truncatedRepeat, sizeof(truncatedRepeat), dst, 8, nullptr));
+    const uint8_t truncatedIndexed[] = { 0x43 };
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::INDEXED_RLE, truncatedIndexed, sizeof(truncatedIndexed), dst, 8, palette));
+    
+    // Runs past the end of the strip
+    const uint8_t longRepeat[] = { 0x48, 1, 2, 3 };
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::RLE, longRepeat, sizeof(longRepeat), dst, 8, nullptr));
+    const uint8_t longSkip[] = { 0x87, 0x80 };
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::DELTA_RLE, longSkip, sizeof(longSkip), dst, 8, nullptr));
+    const uint8_t blockSkip[] = { 0xC0 };
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::DELTA_RLE, blockSkip, sizeof(blockSkip), dst, 8, nullptr));
+    
+    // Indexed payload without a palette
+    const uint8_t indexed[] = { 0x40, 7 };
+    TEST_ASSERT_FALSE(decodeFrame(FrameCodecMode::INDEXED_RLE, indexed, sizeof(indexed), dst, 8, nullptr));
+    TEST_ASSERT_TRUE(decodeFrame(FrameCodecMode::INDEXED_RLE, indexed, sizeof(indexed), dst, 8, palette));
+}
+
+static void test_decode_fuzz_stays_in_bounds() {
+    // Random payloads must either decode or be rejected, never write past count
+    const int count = 100;
+    std::vector<CRGB> guarded(count + 16);
+    CRGB palette[256] = {};
+    uint8_t payload[256];
+    for (int round = 0; round < 20000; round++) {
+        size_t length = nextByte();
+        for (size_t i = 0; i < length; i++) payload[i] = nextByte();
+        for (int i = count; i < count + 16; i++) guarded[i] = CRGB(0xAB, 0xCD, 0xEF);
+        
+        FrameCodecMode mode = (FrameCodecMode)(round % 3);
+        decodeFrame(mode, payload, length, guarded.data(), count, palette);
+        for (int i = count; i < count + 16; i++) {
+            TEST_ASSERT_TRUE(guarded[i] == CRGB(0xAB, 0xCD, 0xEF));
+        }
+    }
+}
+
+// Encoded size per mode and decode cost on consecutive frames of each effect
+static void test_codec_bench() {
+    const int counts[] = { 300, 3000 };
+    const uint32_t frameUs = 16667;
+    for (const EffectInfo& effect : EFFECTS) {
+        if (effect.params & EFFECT_EXTERNAL) continue;
+        for (int count : counts) {
+            std::vector<CRGB> leds(count), previous(count), decoded(count);
+            std::vector<uint8_t> hueMap(count), radiusMap(count);
+            TopologyConfig config = { TopologyType::STRIP, count, 0, false, nullptr };
+            TopologyMaps maps = { hueMap.data(), radiusMap.data(), nullptr };
+            buildTopologyMaps(config, maps);
+            
+            EffectState state;
+            resetEffectState(state);
+            EffectContext ctx = { leds.data(), hueMap.data(), radiusMap.data(), count, CRGB(255, 96, 0),
+                                  200, true, true, frameUs, frameUs };
+            renderEffect(effect.type, ctx, state);
+            ctx.force = false;
+            
+            std::vector<uint8_t> encoded(worstCaseSize(count, 3));
+            const int frames = 60;
+            size_t rleBytes = 0, deltaBytes = 0;
+            uint64_t rleNs = 0, deltaNs = 0;
+            size_t allocations = benchAllocations();
+            for (int frame = 0; frame < frames; frame++) {
+                previous = leds;
+                renderEffect(effect.type, ctx, state);
+                
+                size_t length = encodeFrame(FrameCodecMode::RLE, leds.data(), nullptr, count,
+                                            encoded.data(), encoded.size());
+                rleBytes += length;
+                uint64_t start = benchNowNs();
+                bool ok = decodeFrame(FrameCodecMode::RLE, encoded.data(), length, decoded.data(), count, nullptr);
+                rleNs += benchNowNs() - start;
+                TEST_ASSERT_TRUE(ok);
+                
+                length = encodeFrame(FrameCodecMode::DELTA_RLE, leds.data(), previous.data(), count,
+                                     encoded.data(), encoded.size());
+                deltaBytes += length;
+                decoded = previous;
+                start = benchNowNs();
+                ok = decodeFrame(FrameCodecMode::DELTA_RLE, encoded.data(), length, decoded.data(), count, nullptr);
+                deltaNs += benchNowNs() - start;
+                TEST_ASSERT_TRUE(ok);
+                assertFramesEqual(leds, decoded);
+            }
+            // Same-size vector copies reuse their storage, so any allocation is the codec's
+            TEST_ASSERT_EQUAL(0, benchAllocations() - allocations);
+            
+            double rawBytes = (double)count * 3 * frames;
+            BenchLine("frame_codec")
+                .field("effect", effect.name)
+                .field("pixels", count)
+                .field("rle_ratio", rleBytes / rawBytes)
+                .field("delta_ratio", deltaBytes / rawBytes)
+                .field("rle_decode_ns_per_pixel", (double)rleNs / frames / count)
+                .field("delta_decode_ns_per_pixel", (double)deltaNs / frames / count)
+                .print();
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_rle_round_trip);
+    RUN_TEST(test_rle_long_runs_use_repeats);
+    RUN_TEST(test_delta_round_trip);
+    RUN_TEST(test_delta_unchanged_frame_is_skips);
+    RUN_TEST(test_indexed_round_trip);
+    RUN_TEST(test_encode_rejects_small_buffer);
+    RUN_TEST(test_decode_rejects_malformed);
+    RUN_TEST(test_decode_fuzz_stays_in_bounds);
+    RUN_TEST(test_codec_bench);
+    return UNITY_END();
+}
@@ -0,0 +1,56 @@
+// FrameScheduler deadlines: steady frames report the real dt, a stall is
+// counted as dropped frames, and changing the target fps mid-stream keeps
+// the previous frame start instead of restarting the clock.
+
+#include <unity.h>
+#include "frame_scheduler.h"
+
+void setUp() {}
+void tearDown() {}
+
+static void test_steady_frames() {
+    FrameScheduler scheduler;
+    scheduler.setTargetFps(50);
+    TEST_ASSERT_EQUAL(0, scheduler.beginFrame(1000));
+    TEST_ASSERT_EQUAL(20000, scheduler.timeUntilNextFrame(1000));
+    TEST_ASSERT_EQUAL(20000, scheduler.beginFrame(21000));
+    TEST_ASSERT_EQUAL(20100, scheduler.beginFrame(41100));
+    
+    // Three periods late: two deadlines never happened
+    TEST_ASSERT_EQUAL(60000, scheduler.beginFrame(101100));
+    JsonDocument doc;
+    scheduler.writeStats(doc.to<JsonObject>());
+    TEST_ASSERT_EQUAL(4, (int)doc["frames"]);
+    TEST_ASSERT_EQUAL(2, (int)doc["dropped"]);
+}
+
+static void test_fps_change_keeps_last_frame() {
+    FrameScheduler scheduler;
+    scheduler.setTargetFps(50);
+    scheduler.beginFrame(0);
+    scheduler.beginFrame(20000);
+    
+    // Slower: the wait stretches from the last frame, dt is the real gap
+    scheduler.setTargetFps(10);
+    TEST_ASSERT_EQUAL(10, scheduler.getTargetFps());
+    TEST_ASSERT_EQUAL(90000, scheduler.timeUntilNextFrame(30000));
+    TEST_ASSERT_EQUAL(100000, scheduler.beginFrame(120000));
+    TEST_ASSERT_EQUAL(100000, scheduler.timeUntilNextFrame(120000));
+    
+    // Faster, well into the old period: due now, and the missed
+    // deadlines of the new rate are not counted as drops
+    scheduler.setTargetFps(100);
+    TEST_ASSERT_EQUAL(0, scheduler.timeUntilNextFrame(170000));
+    TEST_ASSERT_EQUAL(50000, scheduler.beginFrame(170000));
+    TEST_ASSERT_EQUAL(10000, scheduler.beginFrame(180000));
+    JsonDocument doc;
+    scheduler.writeStats(doc.to<JsonObject>());
+    TEST_ASSERT_EQUAL(0, (int)doc["dropped"]);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_frames);
+    RUN_TEST(test_fps_change_keeps_last_frame);
+    return UNITY_END();
+}
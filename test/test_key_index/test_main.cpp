@@ -0,0 +1,123 @@
+// KeyIndex against a linear scan through random appends, renames and
+// removals (with duplicate keys and long probe runs), and the cost of an
+// in-place removal against the rebuild it replaces, for 10 to 1,000 keys.
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "key_index.h"
+
+static const int SIZES[] = { 10, 100, 250, 500, 1000 };
+static const int BENCH_REMOVALS = 50;
+
+static uint32_t rngState = 12345;
+
+static uint32_t nextRandom() {
+    rngState = rngState * 1664525 + 1013904223;
+    return rngState >> 8;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static int linearFind(const std::vector<String>& keys, const String& key) {
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] == key) return i;
+    }
+    return -1;
+}
+
+static void checkAll(const KeyIndex& index, const std::vector<String>& keys, int keySpace) {
+    auto keyAt = [&keys](size_t i) -> const String& { return keys[i]; };
+    for (int k = 0; k < keySpace; k++) {
+        String key = "key" + String(k);
+        TEST_ASSERT_EQUAL(linearFind(keys, key), index.find(key, keyAt));
+    }
+}
+
+static void test_matches_linear_scan() {
+    // A small key space forces duplicates; a large one, long runs between rehashes
+    for (int keySpace : { 8, 64, 4000 }) {
+        KeyIndex index;
+        std::vector<String> keys;
+        for (int op = 0; op < 3000; op++) {
+            uint32_t choice = nextRandom() % 10;
+            if (keys.empty() || choice < 5) {
+                keys.push_back("key" + String((int)(nextRandom() % keySpace)));
+                index.add(keys.back(), keys.size() - 1);
+            } else if (choice < 8) {
+                size_t at = nextRandom() % keys.size();
+                index.erase(keys[at], at);
+                keys.erase(keys.begin() + at);
+            } else {
+                size_t at = nextRandom() % keys.size();
+                String renamed = "key" + String((int)(nextRandom() % keySpace));
+                index.remove(keys[at], at);
+                index.add(renamed, at);
+                keys[at] = renamed;
+            }
+            if (op % 97 == 0) checkAll(index, keys, min(keySpace, 200));
+        }
+        checkAll(index, keys, min(keySpace, 200));
+    }
+}
+
+static void test_remove_unknown_entry_is_ignored() {
+    KeyIndex index;
+    index.remove("missing", 0);
+    index.add("a", 0);
+    index.add("b", 1);
+    index.remove("a", 1);           // Right key, wrong position
+    index.remove("c", 0);
+    std::vector<String> keys = { "a", "b" };
+    auto keyAt = [&keys](size_t i) -> const String& { return keys[i]; };
+    TEST_ASSERT_EQUAL(0, index.find("a", keyAt));
+    TEST_ASSERT_EQUAL(1, index.find("b", keyAt));
+}
+
+// Index upkeep per removal from the front half, plus one lookup: erase() in
+// place against clearing and re-adding every key (what eraseDevice() used to
+// cost). The owner's own vector erase is left out of both.
+static void test_bench_removal() {
+    for (int size : SIZES) {
+        std::vector<String> base;
+        for (int i = 0; i < size; i++) base.push_back("BenchDevice" + String(i));
+        int removals = min(BENCH_REMOVALS, size / 2);
+        String probe = base.back();
+        double ns[2];
+        int found = 0;
+        for (int mode = 0; mode < 2; mode++) {
+            std::vector<String> keys = base;
+            KeyIndex index;
+            for (size_t i = 0; i < keys.size(); i++) index.add(keys[i], i);
+            auto keyAt = [&keys](size_t i) -> const String& { return keys[i]; };
+            uint64_t total = 0;
+            for (int r = 0; r < removals; r++) {
+                size_t at = nextRandom() % (keys.size() / 2);
+                String removed = keys[at];
+                keys.erase(keys.begin() + at);
+                uint64_t start = benchNowNs();
+                if (mode == 0) {
+                    index.erase(removed, at);
+                } else {
+                    index.clear();
+                    for (size_t i = 0; i < keys.size(); i++) index.add(keys[i], i);
+                }
+                found += index.find(probe, keyAt) == (int)keys.size() - 1;
+                total += benchNowNs() - start;
+            }
+            ns[mode] = (double)total / removals;
+        }
+        TEST_ASSERT_EQUAL(2 * removals, found);
+        BenchLine("key_index").field("keys", size).field("removals", removals)
+            .field("in_place_ns", ns[0]).field("rebuild_ns", ns[1]).print();
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_linear_scan);
+    RUN_TEST(test_remove_unknown_entry_is_ignored);
+    RUN_TEST(test_bench_removal);
+    return UNITY_END();
+}
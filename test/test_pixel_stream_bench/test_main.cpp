@@ -0,0 +1,205 @@
+// The receive side of the binary pixel stream: every effect's frames are cut
+// into MTU-sized packets the way a phone would send them (raw RGB, RLE and
+// delta RLE), then pushed through parsePixelStreamHeader() and
+// applyPixelStreamPacket() with the end-of-frame copy writeStreamPacket()
+// makes. Reports packets per frame and the frames/sec ceiling of that path;
+// the BLE link itself is not modelled.
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "pixel_stream.h"
+#include "frame_codec.h"
+#include "effect_registry.h"
+#include "topology.h"
+
+static const int PIXEL_COUNTS[] = { 300, 1000 };
+static const int FRAMES = 60;
+static const int DECODE_RUNS = 20;
+static const size_t PACKET_SIZE = 517 - 3;      // The MTU the controller offers, less the ATT header
+static const size_t PAYLOAD_SIZE = PACKET_SIZE - PIXEL_STREAM_HEADER_SIZE;
+
+typedef std::vector<std::vector<uint8_t>> Packets;
+
+void setUp() {}
+void tearDown() {}
+
+static std::vector<uint8_t> makePacket(PixelStreamFormat format, int offset, int count,
+                                       const uint8_t* payload, size_t length) {
+    std::vector<uint8_t> packet(PIXEL_STREAM_HEADER_SIZE);
+    packet[0] = (uint8_t)format;
+    packet[1] = offset & 0xFF;
+    packet[2] = offset >> 8;
+    packet[3] = count & 0xFF;
+    packet[4] = count >> 8;
+    packet.insert(packet.end(), payload, payload + length);
+    return packet;
+}
+
+// Raw RGB: fixed-size slices of the frame
+static Packets packRgb(const std::vector<CRGB>& frame) {
+    Packets packets;
+    int perPacket = PAYLOAD_SIZE / 3;
+    for (int offset = 0; offset < (int)frame.size(); offset += perPacket) {
+        int count = min(perPacket, (int)frame.size() - offset);
+        packets.push_back(makePacket(PixelStreamFormat::RGB, offset, count,
+                                     (const uint8_t*)(frame.data() + offset), count * 3));
+    }
+    packets.back()[0] |= PIXEL_STREAM_END_OF_FRAME;
+    return packets;
+}
+
+// Coded: the longest run of pixels whose encoding fits each packet
+static Packets packCoded(FrameCodecMode mode, const std::vector<CRGB>& frame, const std::vector<CRGB>& previous) {
+    PixelStreamFormat format = mode == FrameCodecMode::RLE ? PixelStreamFormat::RLE : PixelStreamFormat::DELTA_RLE;
+    Packets packets;
+    uint8_t payload[PAYLOAD_SIZE];
+    int total = frame.size();
+    for (int offset = 0; offset < total;) {
+        int low = 1, high = total - offset;
+        while (low < high) {
+            int mid = (low + high + 1) / 2;
+            if (encodeFrame(mode, frame.data() + offset, previous.data() + offset, mid, payload, PAYLOAD_SIZE)) {
+                low = mid;
+            } else {
+                high = mid - 1;
+            }
+        }
+        size_t length = encodeFrame(mode, frame.data() + offset, previous.data() + offset, low, payload,
+                                    PAYLOAD_SIZE);
+        packets.push_back(makePacket(format, offset, low, payload, length));
+        offset += low;
+    }
+    packets.back()[0] |= PIXEL_STREAM_END_OF_FRAME;
+    return packets;
+}
+
+// writeStreamPacket() without the locks: assemble into rx, and on end of
+// frame swap it with the published frame and carry the pixels over
+struct Receiver {
+    std::vector<CRGB> buffers[2];
+    std::vector<CRGB> palette;
+    CRGB* rx;
+    CRGB* published;
+    int count;
+    
+    explicit Receiver(int count) : palette(PIXEL_STREAM_PALETTE_SIZE), count(count) {
+        buffers[0].assign(count, CRGB::Black);
+        buffers[1].assign(count, CRGB::Black);
+        rx = buffers[0].data();
+        published = buffers[1].data();
+    }
+    
+    bool receive(const std::vector<uint8_t>& packet) {
+        PixelStreamHeader header;
+        if (!parsePixelStreamHeader(packet.data(), packet.size(), header)) return false;
+        if ((uint32_t)header.offset + header.count > (uint32_t)count) return false;
+        bool decoded = applyPixelStreamPacket(header, packet.data() + PIXEL_STREAM_HEADER_SIZE,
+                                              packet.size() - PIXEL_STREAM_HEADER_SIZE, rx, palette.data());
+        if (header.endOfFrame && decoded) {
+            CRGB* complete = rx;
+            rx = published;
+            published = complete;
+            memcpy(rx, complete, count * sizeof(CRGB));
+        }
+        return decoded;
+    }
+};
+
+static bool framesEqual(const CRGB* a, const std::vector<CRGB>& b) {
+    return memcmp(a, b.data(), b.size() * sizeof(CRGB)) == 0;
+}
+
+// Nanoseconds per frame to take in every frame's packets, after checking
+// that each frame arrives intact
+static void receiveNs(const std::vector<Packets>& frames, const std::vector<std::vector<CRGB>>& expected,
+                      int count, double& packetsPerFrame, double& nsPerFrame) {
+    Receiver check(count);
+    size_t packets = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        for (const std::vector<uint8_t>& packet : frames[f]) {
+            TEST_ASSERT_TRUE(check.receive(packet));
+        }
+        TEST_ASSERT_TRUE(framesEqual(check.published, expected[f]));
+        packets += frames[f].size();
+    }
+    packetsPerFrame = (double)packets / frames.size();
+    
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < DECODE_RUNS; run++) {
+        Receiver receiver(count);
+        uint64_t start = benchNowNs();
+        for (const Packets& frame : frames) {
+            for (const std::vector<uint8_t>& packet : frame) receiver.receive(packet);
+            benchKeep(receiver.published);
+        }
+        best = min(best, benchNowNs() - start);
+    }
+    nsPerFrame = (double)best / frames.size();
+}
+
+static void test_stream_bench() {
+    const uint32_t frameUs = 16667;
+    for (const EffectInfo& effect : EFFECTS) {
+        if (effect.params & EFFECT_EXTERNAL) continue;
+        for (int count : PIXEL_COUNTS) {
+            std::vector<CRGB> leds(count, CRGB::Black);
+            std::vector<uint8_t> hueMap(count), radiusMap(count);
+            TopologyConfig config = { TopologyType::STRIP, count, 0, false, nullptr };
+            TopologyMaps maps = { hueMap.data(), radiusMap.data(), nullptr };
+            buildTopologyMaps(config, maps);
+            EffectState state;
+            resetEffectState(state);
+            EffectContext ctx = { leds.data(), hueMap.data(), radiusMap.data(), count, CRGB(255, 96, 0),
+                                  200, true, true, frameUs, frameUs };
+            
+            // The receiver starts black, so the first delta is against black
+            std::vector<std::vector<CRGB>> rendered;
+            std::vector<Packets> rgb, rle, delta;
+            std::vector<CRGB> previous(count, CRGB::Black);
+            for (int frame = 0; frame < FRAMES; frame++) {
+                renderEffect(effect.type, ctx, state);
+                ctx.force = false;
+                rendered.push_back(leds);
+                rgb.push_back(packRgb(leds));
+                rle.push_back(packCoded(FrameCodecMode::RLE, leds, previous));
+                delta.push_back(packCoded(FrameCodecMode::DELTA_RLE, leds, previous));
+                previous = leds;
+            }
+            
+            double rgbPackets = 0, rlePackets = 0, deltaPackets = 0;
+            double rgbNs = 0, rleNs = 0, deltaNs = 0;
+            receiveNs(rgb, rendered, count, rgbPackets, rgbNs);
+            receiveNs(rle, rendered, count, rlePackets, rleNs);
+            receiveNs(delta, rendered, count, deltaPackets, deltaNs);
+            BenchLine("pixel_stream")
+                .field("effect", effect.name)
+                .field("pixels", count)
+                .field("rgb_packets", rgbPackets)
+                .field("rgb_fps", 1e9 / rgbNs)
+                .field("rle_packets", rlePackets)
+                .field("rle_fps", 1e9 / rleNs)
+                .field("delta_packets", deltaPackets)
+                .field("delta_fps", 1e9 / deltaNs)
+                .print();
+        }
+    }
+}
+
+// A packet whose range runs past the strip, or a malformed coded payload, is refused
+static void test_rejects_bad_packets() {
+    Receiver receiver(100);
+    uint8_t rgb[3] = { 1, 2, 3 };
+    TEST_ASSERT_FALSE(receiver.receive(makePacket(PixelStreamFormat::RGB, 100, 1, rgb, 3)));
+    TEST_ASSERT_FALSE(receiver.receive(makePacket(PixelStreamFormat::RGB, 0, 2, rgb, 3)));
+    uint8_t literal[2] = { 0x05, 0xFF };    // Promises 6 pixels, carries under one
+    TEST_ASSERT_FALSE(receiver.receive(makePacket(PixelStreamFormat::RLE, 0, 6, literal, 2)));
+    TEST_ASSERT_TRUE(receiver.receive(makePacket(PixelStreamFormat::RGB, 99, 1, rgb, 3)));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_bad_packets);
+    RUN_TEST(test_stream_bench);
+    return UNITY_END();
+}
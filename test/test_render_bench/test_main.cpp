@@ -0,0 +1,168 @@
+// Every effect in the registry at 30 to 30,000 pixels: ns/pixel, frames/sec
+// and heap allocations per frame. "step" frames advance the effect by one
+// animation step (a running animation); "redraw" frames force a full repaint
+// (effect, color or brightness change).
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "effect_registry.h"
+#include "topology.h"
+
+static const int PIXEL_COUNTS[] = { 30, 300, 3000, 30000 };
+static const uint32_t FRAME_US = 16667;
+static const long PIXELS_PER_RUN = 6000000;     // Frames per run scale down with size
+
+struct Strip {
+    std::vector<CRGB> leds;
+    std::vector<uint8_t> hueMap;
+    std::vector<uint8_t> radiusMap;
+    
+    explicit Strip(int count) : leds(count), hueMap(count), radiusMap(count) {
+        TopologyConfig config = { TopologyType::STRIP, count, 0, false, nullptr };
+        TopologyMaps maps = { hueMap.data(), radiusMap.data(), nullptr };
+        buildTopologyMaps(config, maps);
+    }
+    
+    EffectContext context(bool force) {
+        return { leds.data(), hueMap.data(), radiusMap.data(), (int)leds.size(), CRGB(255, 96, 0),
+                 200, true, force, FRAME_US, FRAME_US };
+    }
+};
+
+void setUp() {}
+void tearDown() {}
+
+static void benchEffect(const EffectInfo& effect, int count, bool redraw) {
+    Strip strip(count);
+    EffectState state;
+    resetEffectState(state);
+    // First frame draws everything and builds any lazy tables
+    renderEffect(effect.type, strip.context(true), state);
+    
+    long frames = PIXELS_PER_RUN / count;
+    EffectContext ctx = strip.context(redraw);
+    size_t allocations = benchAllocations();
+    uint64_t start = benchNowNs();
+    for (long frame = 0; frame < frames; frame++) {
+        renderEffect(effect.type, ctx, state);
+        benchKeep(strip.leds.data());
+    }
+    uint64_t elapsed = benchNowNs() - start;
+    size_t allocated = benchAllocations() - allocations;
+    
+    double nsPerFrame = (double)elapsed / frames;
+    BenchLine("render")
+        .field("effect", effect.name)
+        .field("mode", redraw ? "redraw" : "step")
+        .field("pixels", count)
+        .field("frames", (long long)frames)
+        .field("ns_per_pixel", nsPerFrame / count)
+        .field("fps", 1e9 / nsPerFrame)
+        .field("allocs_per_frame", (double)allocated / frames)
+        .print();
+    
+    // Rendering runs every frame on the device and must never touch the heap
+    TEST_ASSERT_EQUAL_UINT32(0, allocated);
+}
+
+static void test_render_all_effects() {
+    for (const EffectInfo& effect : EFFECTS) {
+        if (effect.params & EFFECT_EXTERNAL) continue;
+        for (int count : PIXEL_COUNTS) {
+            benchEffect(effect, count, false);
+            benchEffect(effect, count, true);
+        }
+    }
+}
+
+// The per-pixel loops LEDController ran before the table-driven kernels,
+// one call per animation step, as in the original update*() methods
+struct BaselineState {
+    uint16_t animationIndex = 0;
+};
+
+static void baselineFrame(AnimationType type, CRGB* leds, int numLeds, CRGB color,
+                          uint8_t brightness, BaselineState& state) {
+    uint16_t& animationIndex = state.animationIndex;
+    switch (type) {
+        case AnimationType::SOLID:
+            for (int i = 0; i < numLeds; i++) leds[i] = color;
+            break;
+        case AnimationType::RAINBOW:
+            for (int i = 0; i < numLeds; i++) {
+                leds[i] = CHSV((animationIndex + i * 255 / numLeds) % 255, 255, 255);
+            }
+            animationIndex = (animationIndex + 1) % 255;
+            break;
+        case AnimationType::BREATHE: {
+            uint8_t breatheValue = (sin8(animationIndex) / 255.0) * brightness;
+            for (int i = 0; i < numLeds; i++) {
+                leds[i] = color;
+                leds[i].nscale8(breatheValue);
+            }
+            animationIndex += 2;
+            break;
+        }
+        case AnimationType::THEATER_CHASE:
+            for (int i = 0; i < numLeds; i++) leds[i] = CRGB::Black;
+            for (int i = animationIndex % 3; i < numLeds; i += 3) leds[i] = color;
+            animationIndex = (animationIndex + 1) % 3;
+            break;
+        case AnimationType::COLOR_WIPE:
+            if (animationIndex < numLeds) leds[animationIndex++] = color;
+            break;
+        default:
+            break;
+    }
+}
+
+// ns/pixel per AnimationType, old loops against the registry kernels
+static void test_baseline_vs_table_kernels() {
+    const AnimationType types[] = { AnimationType::SOLID, AnimationType::RAINBOW, AnimationType::BREATHE,
+                                    AnimationType::THEATER_CHASE, AnimationType::COLOR_WIPE };
+    const int counts[] = { 300, 1500, 30000 };
+    for (AnimationType type : types) {
+        for (int count : counts) {
+            Strip strip(count);
+            long frames = PIXELS_PER_RUN / count;
+            
+            BaselineState baseline;
+            uint64_t start = benchNowNs();
+            for (long frame = 0; frame < frames; frame++) {
+                baselineFrame(type, strip.leds.data(), count, CRGB(255, 96, 0), 200, baseline);
+                benchKeep(strip.leds.data());
+            }
+            double beforeNs = (double)(benchNowNs() - start) / frames / count;
+            
+            double afterNs[2];
+            for (int redraw = 0; redraw < 2; redraw++) {
+                EffectState state;
+                resetEffectState(state);
+                renderEffect(type, strip.context(true), state);
+                EffectContext ctx = strip.context(redraw);
+                start = benchNowNs();
+                for (long frame = 0; frame < frames; frame++) {
+                    renderEffect(type, ctx, state);
+                    benchKeep(strip.leds.data());
+                }
+                afterNs[redraw] = (double)(benchNowNs() - start) / frames / count;
+            }
+            
+            BenchLine("render_baseline")
+                .field("effect", effectInfo(type).name)
+                .field("pixels", count)
+                .field("before_ns_per_pixel", beforeNs)
+                .field("after_step_ns_per_pixel", afterNs[0])
+                .field("after_redraw_ns_per_pixel", afterNs[1])
+                .print();
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_render_all_effects);
+    RUN_TEST(test_baseline_vs_table_kernels);
+    return UNITY_END();
+}
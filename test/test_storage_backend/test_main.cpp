@@ -0,0 +1,109 @@
+// The StorageBackend contract, run against every backend: RAM, NVS through
+// the in-process Preferences stand-in, and SPIFFS / LittleFS as directories
+// on the host filesystem. PersistentStorage relies on each of these rules.
+
+#include <unity.h>
+#include <vector>
+#include "storage_backend.h"
+
+static MemoryBackend memoryBackend;
+static NvsBackend nvsBackend("hmztest");
+static SpiffsBackend spiffsBackend;
+static LittleFsBackend littleFsBackend("/store");
+
+void setUp() {}
+void tearDown() {}
+
+static std::vector<uint8_t> bytes(const char* text) {
+    return std::vector<uint8_t>(text, text + strlen(text));
+}
+
+static std::vector<uint8_t> readAll(StorageBackend& backend, const char* path) {
+    std::vector<uint8_t> data(backend.size(path));
+    data.resize(backend.read(path, 0, data.data(), data.size()));
+    return data;
+}
+
+static void checkContract(StorageBackend& backend) {
+    TEST_ASSERT_TRUE(backend.begin());
+    TEST_ASSERT_TRUE(backend.format());
+    uint8_t buffer[16];
+    
+    // Missing files
+    TEST_ASSERT_FALSE(backend.exists("/a.bin"));
+    TEST_ASSERT_EQUAL(0, backend.size("/a.bin"));
+    TEST_ASSERT_EQUAL(0, backend.read("/a.bin", 0, buffer, sizeof(buffer)));
+    TEST_ASSERT_FALSE(backend.remove("/a.bin"));
+    TEST_ASSERT_FALSE(backend.rename("/a.bin", "/b.bin"));
+    
+    // Write, then whole and partial reads
+    std::vector<uint8_t> hello = bytes("hello world");
+    TEST_ASSERT_TRUE(backend.write("/a.bin", hello.data(), hello.size()));
+    TEST_ASSERT_TRUE(backend.exists("/a.bin"));
+    TEST_ASSERT_EQUAL(hello.size(), backend.size("/a.bin"));
+    TEST_ASSERT_TRUE(readAll(backend, "/a.bin") == hello);
+    TEST_ASSERT_EQUAL(5, backend.read("/a.bin", 6, buffer, 5));
+    TEST_ASSERT_EQUAL_MEMORY("world", buffer, 5);
+    TEST_ASSERT_EQUAL(3, backend.read("/a.bin", 8, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_MEMORY("rld", buffer, 3);
+    TEST_ASSERT_EQUAL(0, backend.read("/a.bin", hello.size(), buffer, sizeof(buffer)));
+    
+    // Write replaces, even with something shorter, and a read after it sees the new data
+    std::vector<uint8_t> bye = bytes("bye");
+    TEST_ASSERT_TRUE(backend.write("/a.bin", bye.data(), bye.size()));
+    TEST_ASSERT_TRUE(readAll(backend, "/a.bin") == bye);
+    
+    // Append creates, then extends
+    std::vector<uint8_t> one = bytes("one,");
+    std::vector<uint8_t> two = bytes("two");
+    TEST_ASSERT_TRUE(backend.append("/log.bin", one.data(), one.size()));
+    TEST_ASSERT_TRUE(readAll(backend, "/log.bin") == one);
+    TEST_ASSERT_TRUE(backend.append("/log.bin", two.data(), two.size()));
+    TEST_ASSERT_TRUE(readAll(backend, "/log.bin") == bytes("one,two"));
+    
+    // Rename moves to a new name and replaces an existing target
+    TEST_ASSERT_TRUE(backend.rename("/a.bin", "/b.bin"));
+    TEST_ASSERT_FALSE(backend.exists("/a.bin"));
+    TEST_ASSERT_TRUE(readAll(backend, "/b.bin") == bye);
+    TEST_ASSERT_TRUE(backend.rename("/log.bin", "/b.bin"));
+    TEST_ASSERT_FALSE(backend.exists("/log.bin"));
+    TEST_ASSERT_TRUE(readAll(backend, "/b.bin") == bytes("one,two"));
+    
+    // Remove, and format drops everything
+    TEST_ASSERT_TRUE(backend.write("/c.bin", hello.data(), hello.size()));
+    TEST_ASSERT_TRUE(backend.remove("/b.bin"));
+    TEST_ASSERT_FALSE(backend.exists("/b.bin"));
+    TEST_ASSERT_TRUE(backend.exists("/c.bin"));
+    TEST_ASSERT_TRUE(backend.usedBytes() >= hello.size());
+    TEST_ASSERT_TRUE(backend.totalBytes() > backend.usedBytes());
+    TEST_ASSERT_TRUE(backend.format());
+    TEST_ASSERT_FALSE(backend.exists("/c.bin"));
+}
+
+static void test_memory_backend() { checkContract(memoryBackend); }
+static void test_nvs_backend() { checkContract(nvsBackend); }
+static void test_spiffs_backend() { checkContract(spiffsBackend); }
+static void test_littlefs_backend() { checkContract(littleFsBackend); }
+
+// Stores share a device through separate roots / namespaces
+static void test_backends_are_isolated() {
+    NvsBackend otherNvs("hmzother");
+    LittleFsBackend otherFs("/other");
+    TEST_ASSERT_TRUE(nvsBackend.begin() && otherNvs.begin());
+    TEST_ASSERT_TRUE(littleFsBackend.begin() && otherFs.begin());
+    std::vector<uint8_t> data = bytes("mine");
+    TEST_ASSERT_TRUE(nvsBackend.write("/config.bin", data.data(), data.size()));
+    TEST_ASSERT_TRUE(littleFsBackend.write("/config.bin", data.data(), data.size()));
+    TEST_ASSERT_FALSE(otherNvs.exists("/config.bin"));
+    TEST_ASSERT_FALSE(otherFs.exists("/config.bin"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_memory_backend);
+    RUN_TEST(test_nvs_backend);
+    RUN_TEST(test_spiffs_backend);
+    RUN_TEST(test_littlefs_backend);
+    RUN_TEST(test_backends_are_isolated);
+    return UNITY_END();
+}
@@ -0,0 +1,68 @@
+// Theme command "mode" handling through the effect registry: every effect
+// resolves by name, a command without a mode is accepted (its scalar keys
+// such as brightness or fps still apply), and only unknown names fail.
+
+#include <unity.h>
+#include <ArduinoJson.h>
+#include "effect_registry.h"
+
+void setUp() {}
+void tearDown() {}
+
+// The mode as processThemeCommand reads it
+static void resolveMode(const char* json, bool& known, const EffectInfo*& effect) {
+    JsonDocument doc;
+    TEST_ASSERT_FALSE(deserializeJson(doc, json));
+    const char* mode = doc["mode"];
+    known = findThemeEffect(mode, effect);
+}
+
+static void test_every_effect_resolves() {
+    for (const EffectInfo& info : EFFECTS) {
+        TEST_ASSERT_TRUE(findEffect(info.name) == &info);
+    }
+    bool known = false;
+    const EffectInfo* effect = nullptr;
+    resolveMode("{\"command\":\"theme\",\"mode\":\"rainbow\",\"speed\":40}", known, effect);
+    TEST_ASSERT_TRUE(known);
+    TEST_ASSERT_TRUE(effect != nullptr);
+    TEST_ASSERT_TRUE(effect->type == AnimationType::RAINBOW);
+}
+
+static void test_scalar_only_command_is_accepted() {
+    const char* commands[] = {
+        "{\"command\":\"theme\",\"brightness\":40}",
+        "{\"command\":\"theme\",\"fps\":120}",
+        "{\"command\":\"theme\",\"speed\":20,\"transition\":\"wipe\"}",
+    };
+    for (const char* command : commands) {
+        bool known = false;
+        const EffectInfo* effect = &EFFECTS[0];
+        resolveMode(command, known, effect);
+        TEST_ASSERT_TRUE(known);
+        TEST_ASSERT_TRUE(effect == nullptr);
+    }
+}
+
+static void test_unknown_mode_is_rejected() {
+    const char* commands[] = {
+        "{\"command\":\"theme\",\"mode\":\"disco\",\"brightness\":40}",
+        "{\"command\":\"theme\",\"mode\":\"\"}",
+        "{\"command\":\"theme\",\"mode\":\"Rainbow\"}",
+    };
+    for (const char* command : commands) {
+        bool known = true;
+        const EffectInfo* effect = &EFFECTS[0];
+        resolveMode(command, known, effect);
+        TEST_ASSERT_FALSE(known);
+        TEST_ASSERT_TRUE(effect == nullptr);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_effect_resolves);
+    RUN_TEST(test_scalar_only_command_is_accepted);
+    RUN_TEST(test_unknown_mode_is_rejected);
+    return UNITY_END();
+}
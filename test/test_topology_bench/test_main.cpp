@@ -0,0 +1,198 @@
+// Precomputed topology tables against computing the same mapping per pixel
+// on a serpentine matrix: ripple (radius), rainbow (diagonal hue) and an
+// (x, y) fill through xyTable. The on-the-fly versions use buildMatrix's
+// own math, and are checked to draw the same frames.
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "effect_registry.h"
+#include "topology.h"
+
+static const int MATRIX_SIZES[] = { 32, 64 };
+static const uint32_t FRAME_US = 16667;
+static const long PIXELS_PER_RUN = 1000000;
+static const int BENCH_RUNS = 5;
+
+struct Matrix {
+    int width;
+    int count;
+    std::vector<CRGB> leds;
+    std::vector<uint8_t> hueMap;
+    std::vector<uint8_t> radiusMap;
+    std::vector<uint16_t> xyTable;
+    float centerX;
+    float maxRadius;
+    int span;
+    
+    explicit Matrix(int width)
+        : width(width), count(width * width), leds(count), hueMap(count), radiusMap(count), xyTable(count) {
+        TopologyConfig config = { TopologyType::MATRIX, count, width, true, nullptr };
+        TopologyMaps maps = { hueMap.data(), radiusMap.data(), xyTable.data() };
+        buildTopologyMaps(config, maps);
+        centerX = (width - 1) / 2.0f;
+        maxRadius = sqrtf(2 * centerX * centerX);
+        span = 2 * (width - 1);
+    }
+    
+    void coordinates(int i, int& x, int& y) const {
+        y = i / width;
+        x = i % width;
+        if (y & 1) x = width - 1 - x;
+    }
+    
+    uint8_t radiusAt(int i) const {
+        int x, y;
+        coordinates(i, x, y);
+        float dx = x - centerX;
+        float dy = y - centerX;
+        float radius = sqrtf(dx * dx + dy * dy) * 255.0f / maxRadius;
+        return radius > 255.0f ? 255 : (uint8_t)radius;
+    }
+    
+    uint8_t hueAt(int i) const {
+        int x, y;
+        coordinates(i, x, y);
+        return ((x + y) * 255L) / span;
+    }
+    
+    int indexAt(int x, int y) const {
+        return y * width + ((y & 1) ? width - 1 - x : x);
+    }
+};
+
+// The rainbow effect's colors, read back through an identity hue map
+static CRGB rainbow[256];
+
+static void captureRainbow() {
+    std::vector<CRGB> leds(256);
+    std::vector<uint8_t> hues(256), radius(256);
+    for (int i = 0; i < 256; i++) hues[i] = i;
+    EffectState state;
+    resetEffectState(state);
+    EffectContext ctx = { leds.data(), hues.data(), radius.data(), 256, CRGB::White, 255, true, true, 0, FRAME_US };
+    renderEffect(AnimationType::RAINBOW, ctx, state);
+    memcpy(rainbow, leds.data(), sizeof(rainbow));
+}
+
+// Ripple and rainbow kernels with the map lookup replaced by the computation
+static void rippleOnTheFly(const Matrix& matrix, CRGB* leds, CRGB color, uint8_t wave) {
+    for (int i = 0; i < matrix.count; i++) {
+        CRGB pixel = color;
+        pixel.nscale8(sin8((uint8_t)(matrix.radiusAt(i) - wave)));
+        leds[i] = pixel;
+    }
+}
+
+static void rainbowOnTheFly(const Matrix& matrix, CRGB* leds, uint8_t baseHue) {
+    for (int i = 0; i < matrix.count; i++) {
+        leds[i] = rainbow[(uint8_t)(baseHue + matrix.hueAt(i))];
+    }
+}
+
+// A 2D pattern addressed by (x, y): a diagonal band that moves each frame
+static void fillXyTable(const Matrix& matrix, CRGB* leds, uint8_t phase) {
+    for (int y = 0; y < matrix.width; y++) {
+        for (int x = 0; x < matrix.width; x++) {
+            leds[matrix.xyTable[y * matrix.width + x]] = ((x + y + phase) & 7) ? CRGB(CRGB::Black) : CRGB(CRGB::Red);
+        }
+    }
+}
+
+static void fillXyOnTheFly(const Matrix& matrix, CRGB* leds, uint8_t phase) {
+    for (int y = 0; y < matrix.width; y++) {
+        for (int x = 0; x < matrix.width; x++) {
+            leds[matrix.indexAt(x, y)] = ((x + y + phase) & 7) ? CRGB(CRGB::Black) : CRGB(CRGB::Red);
+        }
+    }
+}
+
+template<typename Frame>
+static double bestNsPerPixel(int count, Frame frame) {
+    long frames = PIXELS_PER_RUN / count;
+    double best = 1e18;
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        uint64_t start = benchNowNs();
+        for (long i = 0; i < frames; i++) frame(i);
+        best = std::min(best, (double)(benchNowNs() - start) / frames / count);
+    }
+    return best;
+}
+
+void setUp() {
+    captureRainbow();
+}
+
+void tearDown() {}
+
+static void test_on_the_fly_matches_tables() {
+    for (int width : MATRIX_SIZES) {
+        Matrix matrix(width);
+        for (int i = 0; i < matrix.count; i++) {
+            TEST_ASSERT_EQUAL(matrix.radiusMap[i], matrix.radiusAt(i));
+            TEST_ASSERT_EQUAL(matrix.hueMap[i], matrix.hueAt(i));
+            int x, y;
+            matrix.coordinates(i, x, y);
+            TEST_ASSERT_EQUAL(i, matrix.xyTable[y * width + x]);
+            TEST_ASSERT_EQUAL(i, matrix.indexAt(x, y));
+        }
+        
+        // Same frames from the effect and from its on-the-fly twin
+        std::vector<CRGB> expected(matrix.count);
+        EffectState state;
+        resetEffectState(state);
+        EffectContext ctx = { matrix.leds.data(), matrix.hueMap.data(), matrix.radiusMap.data(), matrix.count,
+                              CRGB(255, 96, 0), 200, true, true, FRAME_US, FRAME_US };
+        renderEffect(AnimationType::RIPPLE, ctx, state);
+        rippleOnTheFly(matrix, expected.data(), CRGB(255, 96, 0), state.index);
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), matrix.leds.data(), matrix.count * sizeof(CRGB));
+        
+        resetEffectState(state);
+        renderEffect(AnimationType::RAINBOW, ctx, state);
+        rainbowOnTheFly(matrix, expected.data(), state.index);
+        TEST_ASSERT_EQUAL_MEMORY(expected.data(), matrix.leds.data(), matrix.count * sizeof(CRGB));
+    }
+}
+
+static void test_mapping_bench() {
+    for (int width : MATRIX_SIZES) {
+        Matrix matrix(width);
+        CRGB* leds = matrix.leds.data();
+        EffectContext ctx = { leds, matrix.hueMap.data(), matrix.radiusMap.data(), matrix.count,
+                              CRGB(255, 96, 0), 200, true, false, FRAME_US, FRAME_US };
+        EffectState state;
+        
+        struct Row { const char* kernel; double table; double onTheFly; };
+        Row rows[3];
+        
+        resetEffectState(state);
+        rows[0] = { "ripple",
+            bestNsPerPixel(matrix.count, [&](long) { renderEffect(AnimationType::RIPPLE, ctx, state); benchKeep(leds); }),
+            bestNsPerPixel(matrix.count, [&](long i) { rippleOnTheFly(matrix, leds, ctx.color, i * 4); benchKeep(leds); }) };
+        resetEffectState(state);
+        rows[1] = { "rainbow",
+            bestNsPerPixel(matrix.count, [&](long) { renderEffect(AnimationType::RAINBOW, ctx, state); benchKeep(leds); }),
+            bestNsPerPixel(matrix.count, [&](long i) { rainbowOnTheFly(matrix, leds, i); benchKeep(leds); }) };
+        rows[2] = { "xy_fill",
+            bestNsPerPixel(matrix.count, [&](long i) { fillXyTable(matrix, leds, i); benchKeep(leds); }),
+            bestNsPerPixel(matrix.count, [&](long i) { fillXyOnTheFly(matrix, leds, i); benchKeep(leds); }) };
+        
+        for (const Row& row : rows) {
+            BenchLine("topology")
+                .field("kernel", row.kernel)
+                .field("width", width)
+                .field("height", width)
+                .field("table_ns_per_pixel", row.table)
+                .field("on_the_fly_ns_per_pixel", row.onTheFly)
+                .field("speedup", row.onTheFly / row.table)
+                .print();
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_on_the_fly_matches_tables);
+    RUN_TEST(test_mapping_bench);
+    return UNITY_END();
+}
@@ -0,0 +1,171 @@
+// Cost of a transition frame against a plain frame, for every pair of
+// effects and both styles. A transition frame is what renderFrame runs while
+// one is active: a forced redraw of the new effect, then TransitionEngine::
+// render, which redraws the outgoing effect and blends. That is bounded by
+// two effect redraws plus one blend pass, so for effects that cost more than
+// the blend it stays within 2x a plain frame; fills cheaper than the blend
+// itself (solid, color wipe) go above 2x by the blend pass alone.
+
+#include <unity.h>
+#include <vector>
+#include "host_bench.h"
+#include "transition.h"
+#include "pixel_blend.h"
+#include "effect_registry.h"
+#include "topology.h"
+
+static const int PIXEL_COUNTS[] = { 300, 1500 };
+static const uint32_t FRAME_US = 16667;
+static const long PIXELS_PER_RUN = 1000000;
+static const int BENCH_RUNS = 5;
+static const uint16_t LONG_TRANSITION_MS = 65000;   // Outlasts every timed run
+static const double NOISE_MARGIN = 1.25;    // Timing noise, well short of a third render
+
+struct Frame {
+    int count;
+    std::vector<CRGB> leds;
+    std::vector<uint8_t> hueMap;
+    std::vector<uint8_t> radiusMap;
+    FrameAllocator pool;
+    TransitionEngine transition;
+    
+    explicit Frame(int count) : count(count), leds(count), hueMap(count), radiusMap(count) {
+        TopologyConfig config = { TopologyType::STRIP, count, 0, false, nullptr };
+        TopologyMaps maps = { hueMap.data(), radiusMap.data(), nullptr };
+        buildTopologyMaps(config, maps);
+        pool.begin();
+        transition.begin(count, pool);
+    }
+    
+    EffectContext context(CRGB color) {
+        return { leds.data(), hueMap.data(), radiusMap.data(), count, color, 200, true, true, FRAME_US, FRAME_US };
+    }
+};
+
+template<typename Render>
+static double frameNs(long frames, Render render) {
+    uint64_t start = benchNowNs();
+    for (long i = 0; i < frames; i++) render();
+    return (double)(benchNowNs() - start) / frames;
+}
+
+void setUp() {}
+void tearDown() {}
+
+// Halfway through a crossfade every pixel is the average of both effects
+static void test_crossfade_midpoint() {
+    Frame frame(64);
+    frame.transition.configure(TransitionStyle::CROSSFADE, 100);
+    EffectState state;
+    resetEffectState(state);
+    frame.transition.start(AnimationType::SOLID, CRGB(200, 0, 100), state);
+    
+    EffectContext ctx = frame.context(CRGB(0, 200, 100));
+    ctx.dtUs = 50000;
+    renderEffect(AnimationType::SOLID, ctx, state);
+    TEST_ASSERT_TRUE(frame.transition.render(frame.leds.data(), ctx));
+    for (const CRGB& pixel : frame.leds) {
+        TEST_ASSERT_LESS_OR_EQUAL(1, abs(pixel.r - 100));
+        TEST_ASSERT_LESS_OR_EQUAL(1, abs(pixel.g - 100));
+        TEST_ASSERT_EQUAL(100, pixel.b);
+    }
+    
+    // The frame that completes the transition leaves the new effect alone
+    renderEffect(AnimationType::SOLID, ctx, state);
+    TEST_ASSERT_TRUE(frame.transition.render(frame.leds.data(), ctx));
+    TEST_ASSERT_FALSE(frame.transition.isActive());
+    TEST_ASSERT_TRUE(frame.leds[0] == CRGB(0, 200, 100));
+}
+
+static void test_transition_cost() {
+    struct Style { TransitionStyle style; const char* name; };
+    const Style styles[] = { { TransitionStyle::CROSSFADE, "crossfade" }, { TransitionStyle::WIPE, "wipe" } };
+    const CRGB fromColor(255, 96, 0), toColor(0, 80, 255);
+    
+    for (int count : PIXEL_COUNTS) {
+        Frame frame(count);
+        std::vector<CRGB> outgoing(count);
+        long frames = PIXELS_PER_RUN / count;
+        
+        for (const Style& style : styles) {
+            frame.transition.configure(style.style, LONG_TRANSITION_MS);
+            for (const EffectInfo& from : EFFECTS) {
+                if (from.params & EFFECT_EXTERNAL) continue;
+                for (const EffectInfo& to : EFFECTS) {
+                    if (to.params & EFFECT_EXTERNAL) continue;
+                    
+                    // The parts and the whole are timed back to back in each round. Noise
+                    // only ever adds time, so the lowest per-round ratio to the bound is
+                    // the one least disturbed by the host.
+                    double fromNs = 1e18, toNs = 1e18, blendNs = 1e18, transitionNs = 1e18;
+                    double boundRatio = 1e18;
+                    size_t allocations = benchAllocations();
+                    for (int run = 0; run < BENCH_RUNS; run++) {
+                        EffectState fromState, toState;
+                        resetEffectState(fromState);
+                        resetEffectState(toState);
+                        EffectContext outgoingCtx = frame.context(fromColor);
+                        outgoingCtx.leds = outgoing.data();
+                        EffectContext ctx = frame.context(toColor);
+                        
+                        double fromRun = frameNs(frames, [&]() {
+                            renderEffect(from.type, outgoingCtx, fromState);
+                            benchKeep(outgoing.data());
+                        });
+                        double toRun = frameNs(frames, [&]() {
+                            renderEffect(to.type, ctx, toState);
+                            benchKeep(frame.leds.data());
+                        });
+                        // A full crossfade pass, or the average wipe copy
+                        double blendRun = frameNs(frames, [&]() {
+                            if (style.style == TransitionStyle::WIPE) {
+                                memcpy(frame.leds.data() + count / 2, outgoing.data() + count / 2,
+                                       (count - count / 2) * sizeof(CRGB));
+                            } else {
+                                blendLerpBytes((uint8_t*)frame.leds.data(), (const uint8_t*)outgoing.data(),
+                                               count * sizeof(CRGB), 100);
+                            }
+                            benchKeep(frame.leds.data());
+                        });
+                        
+                        frame.transition.start(from.type, fromColor, fromState);
+                        double transitionRun = frameNs(frames, [&]() {
+                            renderEffect(to.type, ctx, toState);
+                            frame.transition.render(frame.leds.data(), ctx);
+                            benchKeep(frame.leds.data());
+                        });
+                        TEST_ASSERT_TRUE(frame.transition.isActive());
+                        
+                        fromNs = std::min(fromNs, fromRun);
+                        toNs = std::min(toNs, toRun);
+                        blendNs = std::min(blendNs, blendRun);
+                        transitionNs = std::min(transitionNs, transitionRun);
+                        boundRatio = std::min(boundRatio, transitionRun / (fromRun + toRun + blendRun));
+                    }
+                    TEST_ASSERT_EQUAL(0, benchAllocations() - allocations);
+                    
+                    double plain = std::max(fromNs, toNs);
+                    BenchLine("transition")
+                        .field("style", style.name)
+                        .field("from", from.name)
+                        .field("to", to.name)
+                        .field("pixels", count)
+                        .field("render_ns_per_pixel", plain / count)
+                        .field("blend_ns_per_pixel", blendNs / count)
+                        .field("transition_ns_per_pixel", transitionNs / count)
+                        .field("ratio", transitionNs / plain)
+                        .print();
+                    TEST_ASSERT_TRUE_MESSAGE(boundRatio <= NOISE_MARGIN,
+                                             "transition frame exceeds two renders plus one blend");
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_crossfade_midpoint);
+    RUN_TEST(test_transition_cost);
+    return UNITY_END();
+}